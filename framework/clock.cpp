@@ -0,0 +1,185 @@
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <time.h>
+#include <errno.h>
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#include "clock.hpp"
+
+
+#if defined( _WIN32 ) && defined( _MSC_VER )
+#pragma comment( lib, "winmm.lib" )
+#endif
+
+
+//-------------------------------------------------------
+//	platform sleep
+//-------------------------------------------------------
+
+namespace
+{
+#ifdef _WIN32
+#ifndef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+#endif
+
+	struct SleepTimer
+	{
+		HANDLE handle = nullptr;
+
+		SleepTimer()
+		{
+			handle = CreateWaitableTimerExW( nullptr, nullptr, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS );
+			// pre Windows 10 1803: raise scheduler granularity instead
+			if ( !handle )
+				timeBeginPeriod( 1 );
+		}
+
+		~SleepTimer()
+		{
+			if ( handle )
+				CloseHandle( handle );
+			else
+				timeEndPeriod( 1 );
+		}
+	};
+
+
+	void platformSleep( double seconds )
+	{
+		thread_local SleepTimer timer;
+
+		if ( timer.handle )
+		{
+			LARGE_INTEGER dueTime;
+			// negative means relative, in 100ns units
+			dueTime.QuadPart = -LONGLONG( seconds * 1e7 );
+			if ( SetWaitableTimer( timer.handle, &dueTime, 0, nullptr, nullptr, FALSE ) )
+			{
+				WaitForSingleObject( timer.handle, INFINITE );
+				return;
+			}
+		}
+		Sleep( DWORD( seconds * 1000.0 ) );
+	}
+#else
+	void platformSleep( double seconds )
+	{
+		timespec request;
+		request.tv_sec = time_t( seconds );
+		request.tv_nsec = long( ( seconds - double( request.tv_sec ) ) * 1e9 );
+		while ( nanosleep( &request, &request ) == -1 && errno == EINTR )
+			;
+	}
+#endif
+}
+
+
+//-------------------------------------------------------
+//	clock interface
+//-------------------------------------------------------
+
+namespace Clock
+{
+	double now()
+	{
+		using namespace std::chrono;
+		return duration< double >( steady_clock::now().time_since_epoch() ).count();
+	}
+
+
+	void sleepFor( double seconds )
+	{
+		if ( seconds > 0.0 )
+			platformSleep( seconds );
+	}
+}
+
+
+//-------------------------------------------------------
+//	frame limiter
+//-------------------------------------------------------
+
+namespace Clock
+{
+	namespace
+	{
+		constexpr double minSpinMargin = 0.0001;
+		constexpr double maxSpinMargin = 0.001;
+	}
+
+
+	void FrameLimiter::reset()
+	{
+		lastTick = now();
+		isResuming = false;
+	}
+
+
+	void FrameLimiter::resume()
+	{
+		isResuming = true;
+	}
+
+
+	double FrameLimiter::wait( double interval )
+	{
+		if ( isResuming )
+		{
+			lastTick = now();
+			isResuming = false;
+			return interval;
+		}
+
+		const double target = lastTick + interval;
+
+		double remaining = target - now();
+		if ( remaining > spinMargin )
+		{
+			const double sleepTime = remaining - spinMargin;
+			const double sleepStart = now();
+			sleepFor( sleepTime );
+
+			// track how late the OS wakes us to keep the spin as short as possible
+			const double oversleep = now() - sleepStart - sleepTime;
+			spinMargin = std::max( minSpinMargin, std::min( maxSpinMargin, 0.9 * spinMargin + 0.1 * 2.0 * std::max( oversleep, 0.0 ) ) );
+		}
+
+		double tick = now();
+		while ( tick < target )
+			tick = now();
+
+		const double frameTime = tick - lastTick;
+		lastTick = tick;
+		record( frameTime, interval );
+		return frameTime;
+	}
+
+
+	void FrameLimiter::record( double frameTime, double interval )
+	{
+		// Welford's running mean and variance
+		frames++;
+		const double delta = frameTime - mean;
+		mean += delta / frames;
+		squaredDeviations += delta * ( frameTime - mean );
+		maxOvershoot = std::max( maxOvershoot, frameTime - interval );
+	}
+
+
+	FrameStats FrameLimiter::stats() const
+	{
+		FrameStats result;
+		result.frames = frames;
+		result.meanFrameTime = mean;
+		result.frameTimeStdDev = frames > 1 ? std::sqrt( squaredDeviations / ( frames - 1 ) ) : 0.0;
+		result.maxOvershoot = maxOvershoot;
+		return result;
+	}
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+
+//-------------------------------------------------------
+//	portable monotonic clock
+//-------------------------------------------------------
+
+namespace Clock
+{
+	// seconds since an arbitrary fixed point
+	double now();
+
+	// high resolution sleep, may still overshoot by the OS wake-up latency
+	void sleepFor( double seconds );
+
+
+	struct FrameStats
+	{
+		int frames = 0;
+		double meanFrameTime = 0.0;
+		double frameTimeStdDev = 0.0;
+		double maxOvershoot = 0.0;
+	};
+
+
+	//-------------------------------------------------------
+	//	hybrid frame limiter: sleeps most of the interval and
+	//	spins only for the last fraction of a millisecond
+	//-------------------------------------------------------
+
+	class FrameLimiter
+	{
+	public:
+		void reset();
+
+		// restart after a pause: the next wait() returns at once
+		// and the paused time is kept out of the statistics
+		void resume();
+
+		// blocks until interval has passed since the previous frame,
+		// returns the real time elapsed
+		double wait( double interval );
+
+		FrameStats stats() const;
+
+	private:
+		void record( double frameTime, double interval );
+
+		double lastTick = 0.0;
+		double spinMargin = 0.0005;
+		bool isResuming = false;
+
+		int frames = 0;
+		double mean = 0.0;
+		double squaredDeviations = 0.0;
+		double maxOvershoot = 0.0;
+	};
+}
@@ -5,8 +5,20 @@
 #include <windowsx.h>
 #include <GL/gl.h>
 
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+#include "clock.hpp"
+#include "engine.hpp"
+#include "fast_forward.hpp"
 #include "game.hpp"
+#include "gl_state.hpp"
+#include "input.hpp"
+#include "latency.hpp"
+#include "replay.hpp"
 #include "scene.hpp"
+#include "spsc_ring.hpp"
 
 
 //-------------------------------------------------------
@@ -20,40 +32,80 @@ namespace
 	constexpr int windowWidth = 1280;
 	constexpr int windowHeight = 720;
 
+	// filled by the window procedure, drained by Game::update
+	SpscRing< Input::Event, 256 > inputEvents;
+	uint32_t nextInputEventId = 1;
+
+	// set for every published frame and on WM_PAINT, the render thread draws on it
+	HANDLE frameReadyEvent = nullptr;
+
+
+	//-------------------------------------------------------
+	void pushInputEvent( Input::Type type, LPARAM lParam )
+	{
+		Input::Event event;
+		event.type = type;
+		event.id = nextInputEventId++;
+		event.x = Scene::screenToWorldX( float( GET_X_LPARAM( lParam ) ) / windowWidth );
+		event.y = Scene::screenToWorldY( 1.f - float( GET_Y_LPARAM( lParam ) ) / windowHeight );
+		event.timestamp = Clock::now();
+		Latency::begin( event.id, event.timestamp );
+
+		// game stalled for hundreds of events: dropping is better than blocking the UI
+		inputEvents.push( event );
+	}
+
 
 	//-------------------------------------------------------
 	LRESULT CALLBACK windowProcedure( HWND hwnd, UINT message, WPARAM wParam, LPARAM lParam )
 	{
 		switch ( message )
 		{
+			// window is destroyed only after the render thread has released it
+			case WM_CLOSE:
+				PostQuitMessage( 0 );
+				return 0;
+
 			case WM_DESTROY:
 				PostQuitMessage( 0 );
 				break;
 
+			// a suspended game publishes nothing, the render thread presents the last frame again
+			case WM_PAINT:
+			{
+				PAINTSTRUCT paint;
+				BeginPaint( hwnd, &paint );
+				EndPaint( hwnd, &paint );
+				if ( frameReadyEvent )
+					SetEvent( frameReadyEvent );
+				return 0;
+			}
+
 			case WM_LBUTTONDOWN:
 			case WM_RBUTTONDOWN:
 			case WM_LBUTTONDBLCLK:
 			case WM_RBUTTONDBLCLK:
-				Game::mouseButtonPressed(
-					Scene::screenToWorldX( float( GET_X_LPARAM( lParam ) ) / windowWidth ),
-					Scene::screenToWorldY( 1.f - float( GET_Y_LPARAM( lParam ) ) / windowHeight ) );
+				pushInputEvent( Input::Type::mouseButtonPressed, lParam );
 				break;
 
 			case WM_LBUTTONUP:
 			case WM_RBUTTONUP:
-				Game::mouseButtonReleased(
-					Scene::screenToWorldX( float( GET_X_LPARAM( lParam ) ) / windowWidth ),
-					Scene::screenToWorldY( 1.f - float( GET_Y_LPARAM( lParam ) ) / windowHeight ) );
+				pushInputEvent( Input::Type::mouseButtonReleased, lParam );
 				break;
 
 			case WM_KEYDOWN:
 				if ( wParam == VK_ESCAPE )
-					DestroyWindow( windowHandle );
+					PostQuitMessage( 0 );
 				if ( wParam == VK_SPACE )
-				{
-					Game::deinit();
-					Game::init();
-				}
+					pushInputEvent( Input::Type::restart, 0 );
+				if ( wParam == VK_ADD || wParam == VK_OEM_PLUS )
+					Engine::setTimeScale( Engine::getTimeScale() * 2.f );
+				if ( wParam == VK_SUBTRACT || wParam == VK_OEM_MINUS )
+					Engine::setTimeScale( Engine::getTimeScale() * 0.5f );
+				if ( wParam == '1' )
+					Engine::setTimeScale( 1.f );
+				if ( wParam == 'S' )
+					Engine::skipToRest();
 				break;
 		}
 		return DefWindowProc( hwnd, message, wParam, lParam );
@@ -155,12 +207,16 @@ namespace
 		using PFNWGLSWAPINTERVALEXTPROC = BOOL (WINAPI *)( int );
 		if ( PFNWGLSWAPINTERVALEXTPROC wglSwapInterval = ( PFNWGLSWAPINTERVALEXTPROC )wglGetProcAddress( "wglSwapIntervalEXT" ) )
 			wglSwapInterval( 0 );
+
+		Gl::setBackend( Gl::openGLBackend() );
+		Scene::setViewport( windowWidth, windowHeight );
 	}
 
 
 	//-------------------------------------------------------
 	void deinitOGL()
 	{
+		Gl::setBackend( nullptr );
 		wglMakeCurrent( nullptr, nullptr );
 		wglDeleteContext( openGLHandle );
 		ReleaseDC( windowHandle, windowDC );
@@ -172,14 +228,69 @@ namespace
 	//-------------------------------------------------------
 	void draw()
 	{
-		Scene::draw();
+		const uint32_t traceId = Scene::draw();
+		Latency::mark( traceId, Latency::Stage::drawn );
 		SwapBuffers( windowDC );
+		Latency::mark( traceId, Latency::Stage::presented );
 
 		assert( glGetError() == 0 );
 	}
 }
 
 
+//-------------------------------------------------------
+//	render thread related stuff
+//-------------------------------------------------------
+
+namespace
+{
+	std::thread renderThread;
+	std::atomic< bool > isRendering = { false };
+
+
+	//-------------------------------------------------------
+	void renderLoop()
+	{
+		// graphics context lives on the render thread only
+		initOGL();
+		while ( isRendering.load( std::memory_order_acquire ) )
+		{
+			WaitForSingleObject( frameReadyEvent, INFINITE );
+			draw();
+		}
+		deinitOGL();
+	}
+
+
+	//-------------------------------------------------------
+	void startRenderThread()
+	{
+		frameReadyEvent = CreateEvent( nullptr, FALSE, FALSE, nullptr );
+		isRendering.store( true, std::memory_order_release );
+		renderThread = std::thread( renderLoop );
+	}
+
+
+	//-------------------------------------------------------
+	void stopRenderThread()
+	{
+		isRendering.store( false, std::memory_order_release );
+		SetEvent( frameReadyEvent );
+		renderThread.join();
+		CloseHandle( frameReadyEvent );
+		frameReadyEvent = nullptr;
+	}
+
+
+	//-------------------------------------------------------
+	void present( float interpolation )
+	{
+		Scene::publishFrame( interpolation );
+		SetEvent( frameReadyEvent );
+	}
+}
+
+
 //-------------------------------------------------------
 //	update and time related stuff
 //-------------------------------------------------------
@@ -190,37 +301,137 @@ namespace
 	constexpr int maxFPS = 200;
 	int targetFPS = maxFPS;
 
-	LARGE_INTEGER clockFrequency;
-	LARGE_INTEGER clockLastTick;
+	char const* replayPath = nullptr;
+	Replay::Writer replayWriter;
+
+	constexpr int minStepsPerSecond = 10;
+	constexpr int maxStepsPerSecond = 1000;
+	int stepsPerSecond = 60;
+
+	// cap on real time fed to the simulation, so it catches up after a stall
+	// instead of spiralling into ever longer frames
+	constexpr double maxFrameTime = 0.25;
+	double stepAccumulator = 0.0;
+
+	constexpr float minTimeScale = 0.1f;
+	constexpr float maxTimeScale = 100.f;
+	float timeScale = 1.f;
+
+	Clock::FrameLimiter frameLimiter;
 
 
 	//-------------------------------------------------------
 	void initClock()
 	{
-		QueryPerformanceFrequency( &clockFrequency );
-		QueryPerformanceCounter( &clockLastTick );
+		frameLimiter.reset();
 	}
 
 
 	//-------------------------------------------------------
-	void update()
+	// runs as many fixed steps as real time allows and
+	// returns the fraction of a step left in the accumulator
+	float update()
 	{
-		float dt = 0.f;
+		const double dt = frameLimiter.wait( 1.0 / targetFPS );
 
-		while ( true )
+		const double stepTime = 1.0 / stepsPerSecond;
+		stepAccumulator += std::min( dt, maxFrameTime ) * timeScale;
+		while ( stepAccumulator >= stepTime )
 		{
-			LARGE_INTEGER clockTick;
-			QueryPerformanceCounter( &clockTick );
-			double deltaTime = double( clockTick.QuadPart - clockLastTick.QuadPart ) / double( clockFrequency.QuadPart );
-			if ( deltaTime >= 1.0 / targetFPS )
+			Scene::beginStep();
+			Game::update( float( stepTime ) );
+			Latency::mark( Scene::stepTraceId(), Latency::Stage::simulated );
+			stepAccumulator -= stepTime;
+		}
+		return float( stepAccumulator / stepTime );
+	}
+}
+
+
+//-------------------------------------------------------
+//	skip to rest
+//-------------------------------------------------------
+
+namespace
+{
+	// a skip gives up after an hour of simulated time
+	constexpr double maxSkipTime = 3600.0;
+	// frames the render thread still gets while the simulation runs ahead
+	constexpr double skipFrameInterval = 0.1;
+
+	FastForward fastForward;
+	bool isSkipping = false;
+
+
+	//-------------------------------------------------------
+	// called on the skipping thread after it published a frame
+	void signalFrameReady()
+	{
+		SetEvent( frameReadyEvent );
+	}
+
+
+	//-------------------------------------------------------
+	// keeps the window responsive while the skip runs,
+	// returns false when frames have to be simulated again
+	bool waitWhileSkipping()
+	{
+		if ( !isSkipping )
+			return false;
+
+		if ( fastForward.isRunning() )
+		{
+			// the player wants the table back, their input waits in the queue for it
+			if ( !inputEvents.isEmpty() )
+				fastForward.cancel();
+			Clock::sleepFor( 1.0 / targetFPS );
+			return true;
+		}
+
+		// the real time spent skipping isn't owed to the simulation
+		fastForward.finish();
+		isSkipping = false;
+		frameLimiter.resume();
+		stepAccumulator = 0.0;
+		return false;
+	}
+}
+
+
+//-------------------------------------------------------
+//	idle suspension
+//-------------------------------------------------------
+
+namespace
+{
+	bool isSuspended = false;
+
+
+	//-------------------------------------------------------
+	// blocks on the message queue while the game is at rest,
+	// returns false when a frame has to be simulated
+	bool suspendWhileIdle()
+	{
+		if ( !inputEvents.isEmpty() || !Game::isQuiescent() )
+		{
+			if ( isSuspended )
 			{
-				dt = float( deltaTime );
-				clockLastTick = clockTick;
-				break;
+				// simulate the waking input right away, without idle time
+				isSuspended = false;
+				frameLimiter.resume();
+				stepAccumulator = 1.0 / stepsPerSecond;
 			}
+			return false;
 		}
 
-		Game::update( dt );
+		if ( !isSuspended )
+		{
+			// settle interpolation on the resting state before stopping
+			isSuspended = true;
+			present( 1.f );
+		}
+		WaitMessage();
+		return true;
 	}
 }
 
@@ -237,19 +448,91 @@ namespace Engine
 	}
 
 
+	void setSimulationRate( int steps )
+	{
+		stepsPerSecond = steps > maxStepsPerSecond ? maxStepsPerSecond : steps < minStepsPerSecond ? minStepsPerSecond : steps;
+	}
+
+
+	// the skip thread leaves input queued, the first event cancels the skip instead
+	bool pollInputEvent( Input::Event& event )
+	{
+		if ( fastForward.isRunning() )
+			return false;
+		return inputEvents.pop( event );
+	}
+
+
+	void recordReplay( char const* path )
+	{
+		replayPath = path;
+	}
+
+
+	bool selectMode( char const* name )
+	{
+		return false;
+	}
+
+
+	Clock::FrameStats getFrameStats()
+	{
+		return frameLimiter.stats();
+	}
+
+
+	int getExitCode()
+	{
+		return 0;
+	}
+
+
+	void setTimeScale( float scale )
+	{
+		timeScale = scale > maxTimeScale ? maxTimeScale : scale < minTimeScale ? minTimeScale : scale;
+	}
+
+
+	float getTimeScale()
+	{
+		return timeScale;
+	}
+
+
+	void skipToRest()
+	{
+		if ( isSkipping )
+			return;
+
+		isSkipping = true;
+		fastForward.start( 1.0 / stepsPerSecond, int( maxSkipTime * stepsPerSecond ), skipFrameInterval, signalFrameReady );
+	}
+
+
 	void run()
 	{
 		initWindow();
-		initOGL();
 		initClock();
 		Game::init();
+		if ( replayPath && replayWriter.open( replayPath, targetFPS ) )
+			Scene::recordFrames( &replayWriter );
+		startRenderThread();
+		present( 1.f );
 		while ( processWindowMessages() )
 		{
-			update();
-			draw();
+			if ( waitWhileSkipping() || suspendWhileIdle() )
+				continue;
+			present( update() );
 		}
+		fastForward.cancel();
+		fastForward.finish();
+		stopRenderThread();
 		Game::deinit();
-		deinitOGL();
 		deinitWindow();
+
+		Scene::recordFrames( nullptr );
+		replayWriter.close();
+
+		Latency::exportCsv( "latency.csv" );
 	}
 }
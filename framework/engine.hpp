@@ -1,10 +1,37 @@
 
 #pragma once
 
+#include "clock.hpp"
+#include "input.hpp"
+
 
 namespace Engine
 {
 	void setTargetFPS( int fps );
+	void setSimulationRate( int stepsPerSecond );
+	Clock::FrameStats getFrameStats();
+
+	// simulated seconds per real second, clamped to [0.1, 100]; rendering keeps its rate
+	void setTimeScale( float scale );
+	float getTimeScale();
+
+	// runs the simulation uncapped on a background thread until the table is at rest,
+	// presenting only a few frames meanwhile; input arriving in between cancels the skip
+	// and is applied once it stopped
+	void skipToRest();
+
+	// next queued input event in arrival order, false when drained or while a skip runs
+	bool pollInputEvent( Input::Event& event );
+
+	// record every presented frame to a replay file, call before run()
+	void recordReplay( char const* path );
+
+	// has run() do one of the engine's checks by name instead of playing, call before run();
+	// false when the engine has no such mode, the windowed engine only plays
+	bool selectMode( char const* name );
+
 	void run();
+	// for the process once run() returned: non-zero when the selected check failed
+	int getExitCode();
 }
 
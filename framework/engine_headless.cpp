@@ -0,0 +1,616 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <random>
+
+#include "clock.hpp"
+#include "engine.hpp"
+#include "fast_forward.hpp"
+#include "frame.hpp"
+#include "game.hpp"
+#include "gl_offscreen.hpp"
+#include "gl_state.hpp"
+#include "grid.hpp"
+#include "input.hpp"
+#include "latency.hpp"
+#include "replay.hpp"
+#include "raster.hpp"
+#include "scene.hpp"
+#include "spsc_ring.hpp"
+
+
+//-------------------------------------------------------
+//	headless engine: no window and no graphics context,
+//	plays a seeded script of shots against a virtual clock
+//	and captures the resting table; the measurements run
+//	as modes of their own, selected on the command line
+//-------------------------------------------------------
+
+namespace
+{
+	constexpr int minFPS = 5;
+	constexpr int maxFPS = 200;
+	int targetFPS = maxFPS;
+
+	char const* replayPath = nullptr;
+	Replay::Writer replayWriter;
+
+	// what run() does
+	enum class Mode
+	{
+		play,
+		latency,
+		compareOpenGL,
+		checkBudgets,
+		skipToRest
+	};
+	Mode mode = Mode::play;
+
+	// same view as the windowed engine
+	constexpr int frameWidth = 1280;
+	constexpr int frameHeight = 720;
+
+	constexpr int minStepsPerSecond = 10;
+	constexpr int maxStepsPerSecond = 1000;
+	int stepsPerSecond = 60;
+
+	double virtualTime = 0.0;
+	double stepAccumulator = 0.0;
+	// what now() reads: the frame's time, and inside a step the time the step starts at
+	double clockTime = 0.0;
+	int frameCount = 0;
+	// set when the selected check failed
+	int exitCode = 0;
+
+	constexpr float minTimeScale = 0.1f;
+	constexpr float maxTimeScale = 100.f;
+	float timeScale = 1.f;
+
+	// a skip gives up after an hour of simulated time
+	constexpr double maxSkipTime = 3600.0;
+	FastForward fastForward;
+
+	SpscRing< Input::Event, 256 > inputEvents;
+	uint32_t nextInputEventId = 1;
+	// popped, but stamped after the start of the step that asked for it
+	Input::Event heldEvent;
+	bool hasHeldEvent = false;
+
+
+	//-------------------------------------------------------
+	double now()
+	{
+		return clockTime;
+	}
+
+
+	//-------------------------------------------------------
+	// like a player's click, input cancels a running skip
+	void pushInputEvent( Input::Type type, float x, float y, double timestamp )
+	{
+		if ( fastForward.isRunning() )
+			fastForward.cancel();
+
+		Input::Event event;
+		event.type = type;
+		event.id = nextInputEventId++;
+		event.x = x;
+		event.y = y;
+		event.timestamp = timestamp;
+		Latency::begin( event.id, event.timestamp );
+		inputEvents.push( event );
+	}
+
+
+	//-------------------------------------------------------
+	// nothing to keep responsive here, the skip is simply waited for;
+	// returns the steps it took, none of which cost virtual time
+	int finishSkip()
+	{
+		const int steps = fastForward.finish();
+		if ( steps > 0 )
+			stepAccumulator = 0.0;
+		return steps;
+	}
+
+
+	//-------------------------------------------------------
+	void frame()
+	{
+		const double frameTime = 1.0 / targetFPS;
+		const double stepTime = 1.0 / stepsPerSecond;
+
+		finishSkip();
+		virtualTime += frameTime;
+		stepAccumulator += frameTime * timeScale;
+		while ( stepAccumulator >= stepTime )
+		{
+			// the steps of a frame each stand for their own slice of it: a step reads
+			// input at its start, and what it simulated is there at its end
+			const double stepStartTime = virtualTime - stepAccumulator / timeScale;
+			clockTime = stepStartTime;
+			Scene::beginStep();
+			Game::update( float( stepTime ) );
+			clockTime = stepStartTime + stepTime / timeScale;
+			Latency::mark( Scene::stepTraceId(), Latency::Stage::simulated );
+			stepAccumulator -= stepTime;
+		}
+		clockTime = virtualTime;
+		Scene::publishFrame( float( stepAccumulator / stepTime ) );
+		frameCount++;
+	}
+
+
+	//-------------------------------------------------------
+	void runUntilQuiescent( double timeLimit )
+	{
+		const double deadline = virtualTime + timeLimit;
+		while ( ( !inputEvents.isEmpty() || hasHeldEvent || !Game::isQuiescent() ) && virtualTime < deadline )
+			frame();
+	}
+
+
+	//-------------------------------------------------------
+	// share of pixels whose colour differs between the two renderers, alpha ignored
+	double differingPixels( Raster::Framebuffer const& first, Raster::Framebuffer const& second )
+	{
+		size_t count = 0;
+		for ( size_t i = 0; i < first.pixels.size(); i++ )
+			count += ( first.pixels[ i ] ^ second.pixels[ i ] ) & 0x00ffffffu ? 1 : 0;
+		return double( count ) / double( first.pixels.size() );
+	}
+
+
+	//-------------------------------------------------------
+	// what the GL call budgets are fixed for: the standard table with its pockets, the
+	// table frame and a rack at fixed spots, so the counts move with the renderer only
+	Scene::Frame budgetScene()
+	{
+		constexpr float tableWidth = 15.f;
+		constexpr float tableHeight = 8.f;
+		constexpr float pocketRadius = 0.4f;
+		constexpr float ballRadius = 0.3f;
+		constexpr Scene::Rgb pocketColor = { 1.f, 0.f, 0.f };
+		constexpr Scene::Rgb ballColor = { 1.f, 1.f, 1.f };
+		constexpr Scene::Rgb frameColor = { 0.05f, 0.05f, 0.05f };
+
+		const float pockets[][ 2 ] = { { -7.5f, 4.f }, { 0.f, 4.f }, { 7.5f, 4.f }, { -7.5f, -4.f }, { 0.f, -4.f }, { 7.5f, -4.f } };
+		const float balls[][ 2 ] = { { -3.75f, 0.f }, { 1.5f, 0.f }, { 2.25f, 0.8f }, { 2.25f, -0.8f }, { 3.f, 1.6f }, { 3.f, 0.f }, { 3.f, -1.6f } };
+
+		Scene::Frame frame;
+		for ( auto const& pocket : pockets )
+			frame.staticCircles.push_back( { pocket[ 0 ], pocket[ 1 ], 0.f, pocket[ 0 ], pocket[ 1 ], 0.f, pocketRadius, pocketColor } );
+
+		const float viewHalfWidth = 0.5f * Scene::View::width;
+		const float viewHalfHeight = 0.5f * Scene::View::height;
+		frame.staticRectangles.push_back( { -viewHalfWidth, viewHalfHeight, -0.5f * tableWidth, -viewHalfHeight, frameColor } );
+		frame.staticRectangles.push_back( { 0.5f * tableWidth, viewHalfHeight, viewHalfWidth, -viewHalfHeight, frameColor } );
+		frame.staticRectangles.push_back( { -0.5f * tableWidth, viewHalfHeight, 0.5f * tableWidth, 0.5f * tableHeight, frameColor } );
+		frame.staticRectangles.push_back( { -0.5f * tableWidth, -0.5f * tableHeight, 0.5f * tableWidth, -viewHalfHeight, frameColor } );
+		// a recording backend is a context of its own, its first draw compiles the layer
+		frame.staticVersion = 1;
+
+		for ( auto const& ball : balls )
+			frame.circles.push_back( { ball[ 0 ], ball[ 1 ], 0.f, ball[ 0 ], ball[ 1 ], 0.f, ballRadius, ballColor } );
+		return frame;
+	}
+
+
+	//-------------------------------------------------------
+	// Scene::draw of the budget scene on the recording backend: from unknown state,
+	// which also compiles the static layer, then steady, then under a vertex budget
+	// the adaptive detail exceeds; a renderer change that sends more calls to the
+	// backend fails the check
+	bool checkGlCalls( Scene::Frame const& frame )
+	{
+		struct Pass
+		{
+			char const* name;
+			int vertexBudget;
+			int callBudget;
+		};
+		const Pass passes[] = { { "first", 1024, 520 }, { "steady", 1024, 235 }, { "capped", 320, 145 } };
+
+		Gl::RecordingBackend recorder;
+		Gl::setBackend( &recorder );
+
+		bool isWithinBudgets = true;
+		for ( Pass const& pass : passes )
+		{
+			Scene::setVertexBudget( pass.vertexBudget );
+			Gl::setFrameBudget( pass.callBudget );
+			Scene::draw( frame );
+
+			const bool isWithinBudget = Gl::isWithinBudget();
+			isWithinBudgets = isWithinBudgets && isWithinBudget;
+
+			Gl::FrameStats const& stats = Gl::lastFrameStats();
+			std::printf( "gl calls, %-6s frame: %d of %d budget (state %d, transform %d, draw %d, vertex %d), %d redundant dropped%s\n",
+				pass.name, stats.total(), pass.callBudget,
+				stats.calls[ int( Gl::Category::state ) ], stats.calls[ int( Gl::Category::transform ) ],
+				stats.calls[ int( Gl::Category::draw ) ], stats.calls[ int( Gl::Category::vertex ) ], stats.dropped,
+				isWithinBudget ? "" : " (OVER BUDGET)" );
+		}
+
+		Scene::setVertexBudget( 0 );
+		Gl::setFrameBudget( 0 );
+		Gl::setBackend( nullptr );
+		return isWithinBudgets;
+	}
+
+
+	//-------------------------------------------------------
+	// 4 by 4 budget scenes composed into one frame and submitted in one draw:
+	// all of them in the overview, only the visible ones when zoomed in
+	bool checkGrid( Scene::Frame const& frame )
+	{
+		const Grid::Layout layout( 16 );
+		const std::vector< Scene::Frame const* > tables( layout.tableCount, &frame );
+		Scene::Frame gridFrame;
+
+		Scene::Camera zoomed = layout.overview();
+		zoomed.centerX = layout.cellX( 0 );
+		zoomed.centerY = layout.cellY( 0 );
+		zoomed.zoom = 0.75f;
+
+		// fixed like the single table's, culling the hidden tables is what keeps the zoomed view cheap
+		struct View
+		{
+			Scene::Camera camera;
+			int callBudget;
+		};
+		const View views[] = { { layout.overview(), 4950 }, { zoomed, 1830 } };
+
+		Gl::RecordingBackend recorder;
+		Gl::setBackend( &recorder );
+
+		bool isWithinBudgets = true;
+		Grid::Composer composer;
+		for ( View const& view : views )
+		{
+			const int composed = composer.compose( tables, layout, view.camera, gridFrame );
+			Gl::setFrameBudget( view.callBudget );
+			Scene::draw( gridFrame );
+
+			const bool isWithinBudget = Gl::isWithinBudget();
+			isWithinBudgets = isWithinBudgets && isWithinBudget;
+			std::printf( "grid view, zoom %.2f: %2d of %d tables drawn, %d of %d gl calls budget%s\n", view.camera.zoom, composed, layout.tableCount,
+				Gl::lastFrameStats().total(), view.callBudget, isWithinBudget ? "" : " (OVER BUDGET)" );
+		}
+
+		Gl::setFrameBudget( 0 );
+		Gl::setBackend( nullptr );
+		return isWithinBudgets;
+	}
+
+
+	//-------------------------------------------------------
+	// the resting table 4 by 4 as the grid overview shows it
+	void captureGrid( Scene::Frame const& frame )
+	{
+		const Grid::Layout layout( 16 );
+		const std::vector< Scene::Frame const* > tables( layout.tableCount, &frame );
+		Scene::Frame gridFrame;
+		Grid::Composer composer;
+		composer.compose( tables, layout, layout.overview(), gridFrame );
+
+		Raster::Framebuffer framebuffer( frameWidth, frameHeight );
+		Raster::render( gridFrame, framebuffer );
+		framebuffer.savePpm( "headless_grid.ppm" );
+	}
+
+
+	//-------------------------------------------------------
+	// --check-budgets: a renderer change sending more GL calls than it did
+	// when the budgets were fixed fails the process, nothing else runs
+	void checkBudgets()
+	{
+		const Scene::Frame scene = budgetScene();
+		const bool isGlCallsWithinBudget = checkGlCalls( scene );
+		const bool isGridWithinBudget = checkGrid( scene );
+		if ( !isGlCallsWithinBudget || !isGridWithinBudget )
+		{
+			std::printf( "gl call budget exceeded\n" );
+			exitCode = 1;
+		}
+	}
+
+
+	//-------------------------------------------------------
+	// --compare-gl: the budget scene drawn by the real OpenGL renderer in an offscreen
+	// context and by the software rasterizer, each timed, then compared pixel by pixel
+	void compareOpenGL()
+	{
+		constexpr int repeats = 200;
+
+		if ( !OffscreenGL::init( frameWidth, frameHeight ) )
+		{
+			std::printf( "offscreen opengl: no context available\n" );
+			exitCode = 1;
+			return;
+		}
+		Scene::setViewport( frameWidth, frameHeight );
+		Gl::setBackend( Gl::openGLBackend() );
+
+		const Scene::Frame scene = budgetScene();
+		Raster::Framebuffer glFramebuffer( frameWidth, frameHeight );
+		const double glStart = Clock::now();
+		for ( int i = 0; i < repeats; i++ )
+		{
+			Scene::draw( scene );
+			OffscreenGL::readback();
+			OffscreenGL::fetch( glFramebuffer );
+		}
+		OffscreenGL::flush( glFramebuffer );
+		const double glTime = ( Clock::now() - glStart ) / repeats;
+		Gl::setBackend( nullptr );
+		OffscreenGL::deinit();
+
+		Raster::Framebuffer framebuffer( frameWidth, frameHeight );
+		Raster::StaticLayer staticLayer;
+		const double rasterStart = Clock::now();
+		for ( int i = 0; i < repeats; i++ )
+			Raster::render( scene, framebuffer, staticLayer );
+		const double rasterTime = ( Clock::now() - rasterStart ) / repeats;
+
+		std::printf( "offscreen opengl: %.3f ms per frame, software raster: %.3f ms per frame, %.2f%% pixels differ\n",
+			glTime * 1e3, rasterTime * 1e3, differingPixels( framebuffer, glFramebuffer ) * 1e2 );
+	}
+
+
+	//-------------------------------------------------------
+	// --skip-to-rest: hours of play in seconds, seeded shots charged at the
+	// highest time scale and skipped to rest, no frame rendered in between;
+	// the clicks go through the input queue like the script's own
+	void reportFastForward()
+	{
+		constexpr int shotCount = 2000;
+
+		std::mt19937 random( 54321 );
+		std::uniform_real_distribution< float > aimX( -7.f, 7.f );
+		std::uniform_real_distribution< float > aimY( -4.f, 4.f );
+
+		const double frameTime = 1.0 / targetFPS;
+		const double stepTime = 1.0 / stepsPerSecond;
+		double simulatedTime = 0.0;
+
+		Game::init();
+		Engine::setTimeScale( maxTimeScale );
+		const double start = Clock::now();
+		for ( int shot = 0; shot < shotCount; shot++ )
+		{
+			// one frame at this scale charges the shot fully, the next one shoots
+			pushInputEvent( Input::Type::mouseButtonPressed, 0.f, 0.f, virtualTime );
+			frame();
+			pushInputEvent( Input::Type::mouseButtonReleased, aimX( random ), aimY( random ), virtualTime );
+			frame();
+			simulatedTime += 2.0 * frameTime * timeScale;
+
+			Engine::skipToRest();
+			simulatedTime += finishSkip() * stepTime;
+		}
+		const double elapsed = Clock::now() - start;
+		Engine::setTimeScale( 1.f );
+		Game::deinit();
+
+		std::printf( "skip to rest: %d shots, %.2f h simulated in %.2f s, %.0fx real time\n",
+			shotCount, simulatedTime / 3600.0, elapsed, simulatedTime / elapsed );
+	}
+
+
+	//-------------------------------------------------------
+	// seeded shots at random aims and charges from a racked table,
+	// each played until the table rests again
+	void playScript()
+	{
+		constexpr int shotCount = 200;
+		constexpr double restTimeLimit = 120.0;
+
+		std::mt19937 random( 12345 );
+		std::uniform_real_distribution< float > aimX( -7.f, 7.f );
+		std::uniform_real_distribution< float > aimY( -4.f, 4.f );
+		std::uniform_real_distribution< double > chargeTime( 0.2, 1.0 );
+		std::uniform_real_distribution< double > framePhase( 0.0, 1.0 );
+
+		runUntilQuiescent( restTimeLimit );
+		for ( int shot = 0; shot < shotCount; shot++ )
+		{
+			const double frameTime = 1.0 / targetFPS;
+
+			// platform events arrive at an arbitrary point of the frame being simulated
+			pushInputEvent( Input::Type::mouseButtonPressed, 0.f, 0.f, virtualTime + framePhase( random ) * frameTime );
+			frame();
+
+			const double releaseTime = virtualTime + chargeTime( random );
+			while ( virtualTime + frameTime < releaseTime )
+				frame();
+			pushInputEvent( Input::Type::mouseButtonReleased, aimX( random ), aimY( random ), virtualTime + framePhase( random ) * frameTime );
+			frame();
+
+			runUntilQuiescent( restTimeLimit );
+		}
+	}
+
+
+	//-------------------------------------------------------
+	void printStage( char const* name, Latency::Stage stage )
+	{
+		std::printf( "%-10s samples: %4d, p50: %7.2f ms, p99: %7.2f ms\n", name, Latency::sampleCount( stage ),
+			Latency::percentile( stage, 0.5 ) * 1e3, Latency::percentile( stage, 0.99 ) * 1e3 );
+	}
+
+
+	//-------------------------------------------------------
+	// --latency: the script timed on the virtual clock, so the latencies
+	// from input to the step that applied it and to the step that moved
+	// the cue ball only depend on the frame pacing
+	void reportLatency()
+	{
+		Latency::setTimeSource( now );
+		Game::init();
+		playScript();
+		Game::deinit();
+		Latency::setTimeSource( Clock::now );
+
+		printStage( "applied", Latency::Stage::applied );
+		printStage( "simulated", Latency::Stage::simulated );
+		Latency::exportCsv( "latency_headless.csv" );
+	}
+}
+
+
+//-------------------------------------------------------
+//	public engine interface
+//-------------------------------------------------------
+
+namespace Engine
+{
+	void setTargetFPS( int fps )
+	{
+		targetFPS = fps > maxFPS ? maxFPS : fps < minFPS ? minFPS : fps;
+	}
+
+
+	void setSimulationRate( int steps )
+	{
+		stepsPerSecond = steps > maxStepsPerSecond ? maxStepsPerSecond : steps < minStepsPerSecond ? minStepsPerSecond : steps;
+	}
+
+
+	Clock::FrameStats getFrameStats()
+	{
+		Clock::FrameStats stats;
+		stats.frames = frameCount;
+		stats.meanFrameTime = 1.0 / targetFPS;
+		return stats;
+	}
+
+
+	int getExitCode()
+	{
+		return exitCode;
+	}
+
+
+	void setTimeScale( float scale )
+	{
+		timeScale = scale > maxTimeScale ? maxTimeScale : scale < minTimeScale ? minTimeScale : scale;
+	}
+
+
+	float getTimeScale()
+	{
+		return timeScale;
+	}
+
+
+	// no intermediate frames, the next frame waits for the skip
+	void skipToRest()
+	{
+		if ( fastForward.isRunning() )
+			return;
+
+		fastForward.start( 1.0 / stepsPerSecond, int( maxSkipTime * stepsPerSecond ), 0.0, nullptr );
+	}
+
+
+	// the skip thread leaves input queued for the next frame;
+	// a step only gets the events stamped before it started
+	bool pollInputEvent( Input::Event& event )
+	{
+		if ( fastForward.isRunning() )
+			return false;
+
+		if ( !hasHeldEvent )
+			hasHeldEvent = inputEvents.pop( heldEvent );
+		if ( !hasHeldEvent || heldEvent.timestamp > clockTime )
+			return false;
+
+		event = heldEvent;
+		hasHeldEvent = false;
+		return true;
+	}
+
+
+	void recordReplay( char const* path )
+	{
+		replayPath = path;
+	}
+
+
+	bool selectMode( char const* name )
+	{
+		if ( std::strcmp( name, "latency" ) == 0 )
+			mode = Mode::latency;
+		else if ( std::strcmp( name, "compare-gl" ) == 0 )
+			mode = Mode::compareOpenGL;
+		else if ( std::strcmp( name, "check-budgets" ) == 0 )
+			mode = Mode::checkBudgets;
+		else if ( std::strcmp( name, "skip-to-rest" ) == 0 )
+			mode = Mode::skipToRest;
+		else
+			return false;
+		return true;
+	}
+
+
+	void run()
+	{
+		if ( mode == Mode::latency )
+		{
+			reportLatency();
+			return;
+		}
+		if ( mode == Mode::compareOpenGL )
+		{
+			compareOpenGL();
+			return;
+		}
+		if ( mode == Mode::checkBudgets )
+		{
+			checkBudgets();
+			return;
+		}
+		if ( mode == Mode::skipToRest )
+		{
+			reportFastForward();
+			return;
+		}
+
+		Raster::Framebuffer framebuffer( frameWidth, frameHeight );
+
+		// the real OpenGL path too, when an offscreen context is available
+		const bool hasOpenGL = OffscreenGL::init( frameWidth, frameHeight );
+		Scene::setViewport( frameWidth, frameHeight );
+		if ( hasOpenGL )
+			Gl::setBackend( Gl::openGLBackend() );
+		Raster::Framebuffer glFramebuffer( frameWidth, frameHeight );
+
+		Game::init();
+		if ( replayPath && replayWriter.open( replayPath, targetFPS, now ) )
+			Scene::recordFrames( &replayWriter );
+		playScript();
+
+		// capture the resting table
+		Raster::render( Scene::acquireFrame(), framebuffer );
+
+		if ( hasOpenGL )
+		{
+			Scene::draw();
+			OffscreenGL::readback();
+		}
+
+		Game::deinit();
+		Scene::recordFrames( nullptr );
+		replayWriter.close();
+		framebuffer.savePpm( "headless_frame.ppm" );
+		if ( hasOpenGL )
+		{
+			OffscreenGL::flush( glFramebuffer );
+			Gl::setBackend( nullptr );
+			OffscreenGL::deinit();
+			glFramebuffer.savePpm( "headless_frame_gl.ppm" );
+		}
+		captureGrid( Scene::acquireFrame() );
+	}
+}
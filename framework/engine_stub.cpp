@@ -0,0 +1,71 @@
+#include "clock.hpp"
+#include "engine.hpp"
+
+
+//-------------------------------------------------------
+//	engine for the tools that simulate off screen: the
+//	game sets its rates and polls input, nothing runs a
+//	window, so every call is a no-op
+//-------------------------------------------------------
+
+namespace Engine
+{
+	void setTargetFPS( int fps )
+	{
+	}
+
+
+	void setSimulationRate( int stepsPerSecond )
+	{
+	}
+
+
+	Clock::FrameStats getFrameStats()
+	{
+		return Clock::FrameStats();
+	}
+
+
+	bool pollInputEvent( Input::Event& event )
+	{
+		return false;
+	}
+
+
+	void recordReplay( char const* path )
+	{
+	}
+
+
+	bool selectMode( char const* name )
+	{
+		return false;
+	}
+
+
+	void setTimeScale( float scale )
+	{
+	}
+
+
+	float getTimeScale()
+	{
+		return 1.f;
+	}
+
+
+	void skipToRest()
+	{
+	}
+
+
+	void run()
+	{
+	}
+
+
+	int getExitCode()
+	{
+		return 0;
+	}
+}
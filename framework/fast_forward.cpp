@@ -0,0 +1,71 @@
+#include "clock.hpp"
+#include "fast_forward.hpp"
+#include "game.hpp"
+#include "latency.hpp"
+#include "scene.hpp"
+
+
+FastForward::~FastForward()
+{
+	cancel();
+	finish();
+}
+
+
+void FastForward::start( double stepTime, int maxSteps, double frameInterval, void ( *onFrame )() )
+{
+	finish();
+
+	steps = 0;
+	isCancelled.store( false, std::memory_order_relaxed );
+	isDone.store( false, std::memory_order_release );
+	worker = std::thread( &FastForward::run, this, stepTime, maxSteps, frameInterval, onFrame );
+}
+
+
+bool FastForward::isRunning() const
+{
+	return !isDone.load( std::memory_order_acquire );
+}
+
+
+void FastForward::cancel()
+{
+	isCancelled.store( true, std::memory_order_relaxed );
+}
+
+
+int FastForward::finish()
+{
+	if ( !worker.joinable() )
+		return 0;
+
+	worker.join();
+	return steps;
+}
+
+
+void FastForward::run( double stepTime, int maxSteps, double frameInterval, void ( *onFrame )() )
+{
+	double lastFrame = Clock::now();
+	while ( steps < maxSteps && !Game::isQuiescent() && !isCancelled.load( std::memory_order_relaxed ) )
+	{
+		Scene::beginStep();
+		Game::update( float( stepTime ) );
+		Latency::mark( Scene::stepTraceId(), Latency::Stage::simulated );
+		steps++;
+
+		if ( frameInterval > 0.0 && Clock::now() - lastFrame >= frameInterval )
+		{
+			Scene::publishFrame( 1.f );
+			if ( onFrame )
+				onFrame();
+			lastFrame = Clock::now();
+		}
+	}
+
+	Scene::publishFrame( 1.f );
+	if ( onFrame )
+		onFrame();
+	isDone.store( true, std::memory_order_release );
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <atomic>
+#include <thread>
+
+
+//-------------------------------------------------------
+//	skip to rest: the game's fixed steps as fast as the
+//	cpu allows on a background thread, which is the
+//	simulation thread until finish(); the engine neither
+//	updates nor presents meanwhile
+//-------------------------------------------------------
+
+class FastForward
+{
+public:
+	FastForward() = default;
+	FastForward( FastForward const& ) = delete;
+	~FastForward();
+
+	// steps until the game is quiescent or maxSteps were taken; every frameInterval
+	// seconds of real time, unless 0, the table is published and onFrame, when given,
+	// is called so a renderer can show the skip decimated; the resting table is published last
+	void start( double stepTime, int maxSteps, double frameInterval, void ( *onFrame )() );
+
+	// the worker is still stepping
+	bool isRunning() const;
+
+	// stops at the next step, the table is left wherever it got to
+	void cancel();
+
+	// waits for the worker, returns the steps it took, 0 when none was started
+	int finish();
+
+private:
+	void run( double stepTime, int maxSteps, double frameInterval, void ( *onFrame )() );
+
+	std::thread worker;
+	std::atomic< bool > isDone = { true };
+	std::atomic< bool > isCancelled = { false };
+	int steps = 0;
+};
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+
+//-------------------------------------------------------
+//	render backend interface: immutable frame snapshot
+//	published by the simulation and consumed by a renderer
+//-------------------------------------------------------
+
+namespace Scene
+{
+	namespace View
+	{
+		constexpr float width = 16.f;
+		constexpr float height = 9.f;
+	}
+
+
+	// part of the world shown: View::width by View::height shrunk by zoom, around the center
+	struct Camera
+	{
+		float centerX = 0.f;
+		float centerY = 0.f;
+		float zoom = 1.f;
+
+		float halfWidth() const { return 0.5f * View::width / zoom; }
+		float halfHeight() const { return 0.5f * View::height / zoom; }
+	};
+
+
+	struct Rgb
+	{
+		float r;
+		float g;
+		float b;
+	};
+
+
+	struct CircleInstance
+	{
+		float previousX;
+		float previousY;
+		float previousAngle;
+		float positionX;
+		float positionY;
+		float angle;
+		float radius;
+		Rgb color;
+
+		// transform interpolated between the last two simulation steps
+		float x( float alpha ) const { return previousX + ( positionX - previousX ) * alpha; }
+		float y( float alpha ) const { return previousY + ( positionY - previousY ) * alpha; }
+		float rotation( float alpha ) const { return previousAngle + ( angle - previousAngle ) * alpha; }
+	};
+
+
+	// axis aligned, in world units with y pointing up
+	struct RectangleInstance
+	{
+		float left;
+		float top;
+		float right;
+		float bottom;
+		Rgb color;
+	};
+
+
+	struct Frame
+	{
+		Rgb clearColor = { 0.1f, 0.4f, 0.2f };
+		Camera camera;
+
+		// table layer drawn first: pockets, then the table frame over them;
+		// it changes only with a new staticVersion, so renderers cache it
+		std::vector< CircleInstance > staticCircles;
+		std::vector< RectangleInstance > staticRectangles;
+		uint32_t staticVersion = 0;
+
+		std::vector< CircleInstance > circles;
+		// drawn over the circles: progress bar
+		std::vector< RectangleInstance > rectangles;
+		float interpolation = 1.f;
+		uint32_t traceId = 0;
+	};
+}
@@ -1,6 +1,13 @@
 
 #pragma once
 
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+
+class Simulation;
+
 
 namespace Game
 {
@@ -8,6 +15,113 @@ namespace Game
 	void deinit();
 	void update( float dt );
 
+	// table variants, each simulated by code compiled for its own layout
+	enum class Variant
+	{
+		standard,	// 7 balls, 6 pockets
+		pool,		// 16 balls
+		snooker,	// 22 smaller balls, narrower pockets
+		carom,		// 3 balls, no pockets
+		stress,		// 4096 small balls
+		huge,		// 65536 tiny balls, storage kept in Morton order
+		custom		// the counts given below, configured at runtime
+	};
+
+	// table variant from the next init() on
+	void setVariant( Variant variant );
+
+	// the standard table with other counts, switches to Variant::custom:
+	// the cue ball and a rack behind it, pockets spread along the long cushions
+	void setBallCount( int count );
+	void setPocketCount( int count );
+
+	// tables too big for the cache, the huge one, keep ball storage in Morton order of
+	// the positions for cache locality; on by default, off only to measure what it saves
+	void setBallSorting( bool isEnabled );
+
+	// constants of the physics, picked by hand; settable for calibration
+	struct Physics
+	{
+		float friction = 0.03f;		// rolling resistance, as a share of gravity
+		float impulse = 6.f;		// cue ball speed of a fully charged shot
+		float accurance = 0.01f;	// balls slower than this are at rest
+	};
+
+	// applies from the next step on, to every table variant
+	void setPhysics( Physics const& physics );
+	Physics getPhysics();
+
+	// a ball by id, the cue ball is 0
+	struct Ball
+	{
+		float x = 0.f;
+		float y = 0.f;
+		bool isPocketed = false;
+	};
+	using TableState = std::vector< Ball >;
+
+	// the cue's direction needs no normalizing, power is the charge in [0, 1]
+	struct Shot
+	{
+		float directionX = 1.f;
+		float directionY = 0.f;
+		float power = 1.f;
+	};
+
+	struct ShotOutcome
+	{
+		TableState rest;
+		// ids in the order they dropped
+		std::vector< int > pocketed;
+		// the cue ball dropped, the others stay where they were at that moment
+		bool isScratch = false;
+		int steps = 0;
+		// hashTable( rest ), kept up while the shot ran
+		uint64_t hash = 0;
+	};
+
+	// Zobrist style hashes for game tree search: a ball on the table keys its id and
+	// its position snapped to hashCellSize, a pocketed one its id alone, and a table
+	// xors its balls' keys, so a ball moving or dropping changes the hash by two keys;
+	// resting layouts reached by different shots hash alike when every ball is in the same cell
+	constexpr float hashCellSize = 0.01f;
+	uint64_t hashBall( int id, Ball const& ball );
+	uint64_t hashTable( TableState const& state );
+	// whatever else tells two positions apart, the player to shoot say, for the search to xor in
+	uint64_t hashGameState( uint32_t value );
+
+	// shots simulated off screen, independent of the game and of each other:
+	// every thread can own one
+	class ShotSimulator
+	{
+	public:
+		// the variant's table, custom takes the counts set for the game
+		explicit ShotSimulator( Variant variant = Variant::standard );
+		ShotSimulator( ShotSimulator const& ) = delete;
+		~ShotSimulator();
+
+		void setPhysics( Physics const& physics );
+		Physics const& getPhysics() const;
+		// like Game::setBallSorting, for this simulator's table
+		void setBallSorting( bool isEnabled );
+
+		TableState const& rack() const;
+		// tells the variants apart, and custom tables of different counts
+		uint64_t layoutHash() const;
+		float tableWidth() const;
+		float tableHeight() const;
+		ShotOutcome simulate( TableState const& start, Shot const& shot );
+
+	private:
+		std::unique_ptr< Simulation > simulation;
+		Physics physics;
+		TableState rackState;
+	};
+
+	// nothing changes until the next input, the engine may stop updating
+	bool isQuiescent();
+
 	void mouseButtonPressed( float x, float y );
-	void mouseButtonReleased( float x, float y );
+	// traceId ties the resulting shot to the input's latency trace
+	void mouseButtonReleased( float x, float y, uint32_t traceId = 0 );
 }
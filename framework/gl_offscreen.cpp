@@ -0,0 +1,324 @@
+#ifdef MINIBILL_OSMESA
+#include <GL/osmesa.h>
+#else
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+#include <GL/gl.h>
+#include <GL/glext.h>
+
+#include <cstring>
+#include <vector>
+
+#include "gl_offscreen.hpp"
+
+
+//-------------------------------------------------------
+//	context creation
+//-------------------------------------------------------
+
+namespace
+{
+	int width = 0;
+	int height = 0;
+
+#ifdef MINIBILL_OSMESA
+	OSMesaContext context = nullptr;
+	// OSMesa needs a color buffer of its own even though we draw into an FBO
+	std::vector< uint32_t > contextBuffer;
+
+
+	void* getProcAddress( char const* name )
+	{
+		return reinterpret_cast< void* >( OSMesaGetProcAddress( name ) );
+	}
+
+
+	bool createContext()
+	{
+		context = OSMesaCreateContextExt( OSMESA_RGBA, 0, 0, 0, nullptr );
+		if ( !context )
+			return false;
+		contextBuffer.assign( size_t( width ) * height, 0 );
+		return OSMesaMakeCurrent( context, contextBuffer.data(), GL_UNSIGNED_BYTE, width, height );
+	}
+
+
+	void destroyContext()
+	{
+		if ( context )
+			OSMesaDestroyContext( context );
+		context = nullptr;
+		contextBuffer.clear();
+	}
+#else
+	EGLDisplay display = EGL_NO_DISPLAY;
+	EGLContext context = EGL_NO_CONTEXT;
+
+
+	void* getProcAddress( char const* name )
+	{
+		return reinterpret_cast< void* >( eglGetProcAddress( name ) );
+	}
+
+
+	bool createContext()
+	{
+		auto getPlatformDisplay = reinterpret_cast< PFNEGLGETPLATFORMDISPLAYEXTPROC >( eglGetProcAddress( "eglGetPlatformDisplayEXT" ) );
+		if ( getPlatformDisplay )
+			display = getPlatformDisplay( EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr );
+		if ( display == EGL_NO_DISPLAY )
+			display = eglGetDisplay( EGL_DEFAULT_DISPLAY );
+
+		EGLint major = 0;
+		EGLint minor = 0;
+		if ( display == EGL_NO_DISPLAY || !eglInitialize( display, &major, &minor ) || !eglBindAPI( EGL_OPENGL_API ) )
+			return false;
+
+		const EGLint configAttributes[] = { EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_NONE };
+		EGLConfig config = nullptr;
+		EGLint configCount = 0;
+		if ( !eglChooseConfig( display, configAttributes, &config, 1, &configCount ) || configCount == 0 )
+			config = nullptr;	// EGL_KHR_no_config_context
+
+		// default attributes give a compatibility context, scene.cpp uses fixed function
+		context = eglCreateContext( display, config, EGL_NO_CONTEXT, nullptr );
+		if ( context == EGL_NO_CONTEXT )
+			return false;
+		return eglMakeCurrent( display, EGL_NO_SURFACE, EGL_NO_SURFACE, context );
+	}
+
+
+	void destroyContext()
+	{
+		if ( display != EGL_NO_DISPLAY )
+		{
+			eglMakeCurrent( display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT );
+			if ( context != EGL_NO_CONTEXT )
+				eglDestroyContext( display, context );
+			eglTerminate( display );
+		}
+		context = EGL_NO_CONTEXT;
+		display = EGL_NO_DISPLAY;
+	}
+#endif
+}
+
+
+//-------------------------------------------------------
+//	render target and asynchronous readback
+//-------------------------------------------------------
+
+namespace
+{
+	struct Functions
+	{
+		PFNGLGENFRAMEBUFFERSPROC genFramebuffers;
+		PFNGLDELETEFRAMEBUFFERSPROC deleteFramebuffers;
+		PFNGLBINDFRAMEBUFFERPROC bindFramebuffer;
+		PFNGLGENRENDERBUFFERSPROC genRenderbuffers;
+		PFNGLDELETERENDERBUFFERSPROC deleteRenderbuffers;
+		PFNGLBINDRENDERBUFFERPROC bindRenderbuffer;
+		PFNGLRENDERBUFFERSTORAGEPROC renderbufferStorage;
+		PFNGLFRAMEBUFFERRENDERBUFFERPROC framebufferRenderbuffer;
+		PFNGLCHECKFRAMEBUFFERSTATUSPROC checkFramebufferStatus;
+		PFNGLGENBUFFERSPROC genBuffers;
+		PFNGLDELETEBUFFERSPROC deleteBuffers;
+		PFNGLBINDBUFFERPROC bindBuffer;
+		PFNGLBUFFERDATAPROC bufferData;
+		PFNGLMAPBUFFERRANGEPROC mapBufferRange;
+		PFNGLUNMAPBUFFERPROC unmapBuffer;
+		// optional, without fences a readback counts as ready once the ring is full
+		PFNGLFENCESYNCPROC fenceSync;
+		PFNGLCLIENTWAITSYNCPROC clientWaitSync;
+		PFNGLDELETESYNCPROC deleteSync;
+	};
+
+	Functions gl = {};
+
+
+	template< class Function >
+	bool load( Function& function, char const* name )
+	{
+		function = reinterpret_cast< Function >( getProcAddress( name ) );
+		return function != nullptr;
+	}
+
+
+	bool loadFunctions()
+	{
+		load( gl.fenceSync, "glFenceSync" );
+		load( gl.clientWaitSync, "glClientWaitSync" );
+		load( gl.deleteSync, "glDeleteSync" );
+
+		return load( gl.genFramebuffers, "glGenFramebuffers" ) &&
+			load( gl.deleteFramebuffers, "glDeleteFramebuffers" ) &&
+			load( gl.bindFramebuffer, "glBindFramebuffer" ) &&
+			load( gl.genRenderbuffers, "glGenRenderbuffers" ) &&
+			load( gl.deleteRenderbuffers, "glDeleteRenderbuffers" ) &&
+			load( gl.bindRenderbuffer, "glBindRenderbuffer" ) &&
+			load( gl.renderbufferStorage, "glRenderbufferStorage" ) &&
+			load( gl.framebufferRenderbuffer, "glFramebufferRenderbuffer" ) &&
+			load( gl.checkFramebufferStatus, "glCheckFramebufferStatus" ) &&
+			load( gl.genBuffers, "glGenBuffers" ) &&
+			load( gl.deleteBuffers, "glDeleteBuffers" ) &&
+			load( gl.bindBuffer, "glBindBuffer" ) &&
+			load( gl.bufferData, "glBufferData" ) &&
+			load( gl.mapBufferRange, "glMapBufferRange" ) &&
+			load( gl.unmapBuffer, "glUnmapBuffer" );
+	}
+
+
+	GLuint framebuffer = 0;
+	GLuint colorbuffer = 0;
+
+	constexpr int readbackDepth = 3;
+
+	struct Readback
+	{
+		GLuint buffer = 0;
+		GLsync fence = nullptr;
+	};
+
+	Readback readbacks[ readbackDepth ];
+	int queuedReadbacks = 0;
+	int oldestReadback = 0;
+
+
+	bool isReady( Readback const& readback )
+	{
+		if ( !readback.fence || !gl.clientWaitSync )
+			return queuedReadbacks == readbackDepth;
+		const GLenum status = gl.clientWaitSync( readback.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0 );
+		return status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED;
+	}
+
+
+	void releaseOldest( Raster::Framebuffer* target )
+	{
+		Readback& readback = readbacks[ oldestReadback ];
+
+		if ( target )
+		{
+			gl.bindBuffer( GL_PIXEL_PACK_BUFFER, readback.buffer );
+			const size_t rowSize = size_t( width ) * sizeof( uint32_t );
+			if ( auto const* pixels = static_cast< unsigned char const* >( gl.mapBufferRange( GL_PIXEL_PACK_BUFFER, 0, GLsizeiptr( rowSize * height ), GL_MAP_READ_BIT ) ) )
+			{
+				// GL rows go bottom up, the raster framebuffer top down
+				for ( int y = 0; y < height; y++ )
+					std::memcpy( &target->pixels[ size_t( height - 1 - y ) * width ], pixels + rowSize * y, rowSize );
+				gl.unmapBuffer( GL_PIXEL_PACK_BUFFER );
+			}
+			gl.bindBuffer( GL_PIXEL_PACK_BUFFER, 0 );
+		}
+
+		if ( readback.fence )
+			gl.deleteSync( readback.fence );
+		readback.fence = nullptr;
+
+		oldestReadback = ( oldestReadback + 1 ) % readbackDepth;
+		queuedReadbacks--;
+	}
+}
+
+
+//-------------------------------------------------------
+//	public interface
+//-------------------------------------------------------
+
+namespace OffscreenGL
+{
+	bool init( int frameWidth, int frameHeight )
+	{
+		width = frameWidth;
+		height = frameHeight;
+
+		if ( !createContext() || !loadFunctions() )
+		{
+			destroyContext();
+			return false;
+		}
+
+		gl.genRenderbuffers( 1, &colorbuffer );
+		gl.bindRenderbuffer( GL_RENDERBUFFER, colorbuffer );
+		gl.renderbufferStorage( GL_RENDERBUFFER, GL_RGBA8, width, height );
+
+		gl.genFramebuffers( 1, &framebuffer );
+		gl.bindFramebuffer( GL_FRAMEBUFFER, framebuffer );
+		gl.framebufferRenderbuffer( GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorbuffer );
+		if ( gl.checkFramebufferStatus( GL_FRAMEBUFFER ) != GL_FRAMEBUFFER_COMPLETE )
+		{
+			deinit();
+			return false;
+		}
+		glViewport( 0, 0, width, height );
+
+		for ( Readback& readback : readbacks )
+		{
+			gl.genBuffers( 1, &readback.buffer );
+			gl.bindBuffer( GL_PIXEL_PACK_BUFFER, readback.buffer );
+			gl.bufferData( GL_PIXEL_PACK_BUFFER, GLsizeiptr( width ) * height * 4, nullptr, GL_STREAM_READ );
+		}
+		gl.bindBuffer( GL_PIXEL_PACK_BUFFER, 0 );
+
+		queuedReadbacks = 0;
+		oldestReadback = 0;
+		return true;
+	}
+
+
+	void deinit()
+	{
+		if ( gl.deleteBuffers )
+		{
+			while ( queuedReadbacks > 0 )
+				releaseOldest( nullptr );
+			for ( Readback& readback : readbacks )
+			{
+				gl.deleteBuffers( 1, &readback.buffer );
+				readback.buffer = 0;
+			}
+			gl.deleteFramebuffers( 1, &framebuffer );
+			gl.deleteRenderbuffers( 1, &colorbuffer );
+		}
+		framebuffer = 0;
+		colorbuffer = 0;
+		gl = {};
+		destroyContext();
+	}
+
+
+	void readback()
+	{
+		// the oldest frame nobody fetched is dropped rather than stalling the pipeline
+		if ( queuedReadbacks == readbackDepth )
+			releaseOldest( nullptr );
+
+		Readback& readback = readbacks[ ( oldestReadback + queuedReadbacks ) % readbackDepth ];
+		gl.bindBuffer( GL_PIXEL_PACK_BUFFER, readback.buffer );
+		glReadPixels( 0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr );
+		gl.bindBuffer( GL_PIXEL_PACK_BUFFER, 0 );
+		if ( gl.fenceSync )
+			readback.fence = gl.fenceSync( GL_SYNC_GPU_COMMANDS_COMPLETE, 0 );
+		queuedReadbacks++;
+	}
+
+
+	bool fetch( Raster::Framebuffer& target )
+	{
+		if ( queuedReadbacks == 0 || !isReady( readbacks[ oldestReadback ] ) )
+			return false;
+		releaseOldest( &target );
+		return true;
+	}
+
+
+	bool flush( Raster::Framebuffer& target )
+	{
+		if ( queuedReadbacks == 0 )
+			return false;
+		while ( queuedReadbacks > 0 )
+			releaseOldest( &target );
+		return true;
+	}
+}
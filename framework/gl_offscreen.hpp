@@ -0,0 +1,28 @@
+#pragma once
+
+#include "raster.hpp"
+
+
+//-------------------------------------------------------
+//	offscreen OpenGL context for machines without display or GPU:
+//	EGL surfaceless (Mesa llvmpipe) by default, OSMesa when built
+//	with MINIBILL_OSMESA; renders into a framebuffer object and
+//	reads frames back asynchronously through pixel buffer objects
+//-------------------------------------------------------
+
+namespace OffscreenGL
+{
+	// creates the context and makes it current on the calling thread
+	bool init( int width, int height );
+	void deinit();
+
+	// queues a non-blocking readback of what was just drawn
+	void readback();
+
+	// copies the oldest finished readback into target (top row first),
+	// false while no queued frame is ready yet
+	bool fetch( Raster::Framebuffer& target );
+
+	// waits for every queued readback, the last one ends up in target
+	bool flush( Raster::Framebuffer& target );
+}
@@ -0,0 +1,130 @@
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#endif
+#include <GL/gl.h>
+
+#include "gl_state.hpp"
+
+
+//-------------------------------------------------------
+//	backend issuing fixed function OpenGL calls,
+//	kept apart so mock-only builds need no GL library
+//-------------------------------------------------------
+
+namespace Gl
+{
+	namespace
+	{
+		class OpenGLBackend : public Backend
+		{
+		public:
+			void matrixMode( MatrixMode mode ) override
+			{
+				glMatrixMode( mode == MatrixMode::projection ? GL_PROJECTION : GL_MODELVIEW );
+			}
+
+			void loadIdentity() override
+			{
+				glLoadIdentity();
+			}
+
+			void scale( float x, float y, float z ) override
+			{
+				glScalef( x, y, z );
+			}
+
+			void translate( float x, float y, float z ) override
+			{
+				glTranslatef( x, y, z );
+			}
+
+			void rotateZ( float degrees ) override
+			{
+				glRotatef( degrees, 0.f, 0.f, 1.f );
+			}
+
+			void setEnabled( Capability capability, bool isEnabled ) override
+			{
+				const GLenum name = capability == Capability::cullFace ? GL_CULL_FACE : 0;
+				if ( isEnabled )
+					glEnable( name );
+				else
+					glDisable( name );
+			}
+
+			void clearColor( float r, float g, float b, float a ) override
+			{
+				glClearColor( r, g, b, a );
+			}
+
+			void clear() override
+			{
+				glClear( GL_COLOR_BUFFER_BIT );
+			}
+
+			void color( float r, float g, float b ) override
+			{
+				glColor3f( r, g, b );
+			}
+
+			void begin( Primitive primitive ) override
+			{
+				switch ( primitive )
+				{
+					case Primitive::triangles:
+						glBegin( GL_TRIANGLES );
+						break;
+					case Primitive::triangleStrip:
+						glBegin( GL_TRIANGLE_STRIP );
+						break;
+					case Primitive::triangleFan:
+						glBegin( GL_TRIANGLE_FAN );
+						break;
+				}
+			}
+
+			void vertex( float x, float y ) override
+			{
+				glVertex2f( x, y );
+			}
+
+			void end() override
+			{
+				glEnd();
+			}
+
+			uint32_t createList() override
+			{
+				return glGenLists( 1 );
+			}
+
+			void deleteList( uint32_t list ) override
+			{
+				glDeleteLists( list, 1 );
+			}
+
+			void beginList( uint32_t list ) override
+			{
+				glNewList( list, GL_COMPILE );
+			}
+
+			void endList() override
+			{
+				glEndList();
+			}
+
+			void callList( uint32_t list ) override
+			{
+				glCallList( list );
+			}
+		};
+	}
+
+
+	Backend* openGLBackend()
+	{
+		static OpenGLBackend backend;
+		return &backend;
+	}
+}
@@ -0,0 +1,452 @@
+#include <cassert>
+
+#include "gl_state.hpp"
+
+
+namespace Gl
+{
+	int FrameStats::total() const
+	{
+		int sum = 0;
+		for ( int count : calls )
+			sum += count;
+		return sum;
+	}
+
+
+	Backend::~Backend()
+	{
+	}
+}
+
+
+//-------------------------------------------------------
+//	recording backend
+//-------------------------------------------------------
+
+namespace Gl
+{
+	void RecordingBackend::record( Op op, float a, float b, float c, float d )
+	{
+		commands.push_back( { op, { a, b, c, d } } );
+	}
+
+
+	void RecordingBackend::matrixMode( MatrixMode mode )
+	{
+		record( Op::matrixMode, float( mode ) );
+	}
+
+
+	void RecordingBackend::loadIdentity()
+	{
+		record( Op::loadIdentity );
+	}
+
+
+	void RecordingBackend::scale( float x, float y, float z )
+	{
+		record( Op::scale, x, y, z );
+	}
+
+
+	void RecordingBackend::translate( float x, float y, float z )
+	{
+		record( Op::translate, x, y, z );
+	}
+
+
+	void RecordingBackend::rotateZ( float degrees )
+	{
+		record( Op::rotateZ, degrees );
+	}
+
+
+	void RecordingBackend::setEnabled( Capability capability, bool isEnabled )
+	{
+		record( Op::setEnabled, float( capability ), isEnabled ? 1.f : 0.f );
+	}
+
+
+	void RecordingBackend::clearColor( float r, float g, float b, float a )
+	{
+		record( Op::clearColor, r, g, b, a );
+	}
+
+
+	void RecordingBackend::clear()
+	{
+		record( Op::clear );
+	}
+
+
+	void RecordingBackend::color( float r, float g, float b )
+	{
+		record( Op::color, r, g, b );
+	}
+
+
+	void RecordingBackend::begin( Primitive primitive )
+	{
+		record( Op::begin, float( primitive ) );
+	}
+
+
+	void RecordingBackend::vertex( float x, float y )
+	{
+		record( Op::vertex, x, y );
+	}
+
+
+	void RecordingBackend::end()
+	{
+		record( Op::end );
+	}
+
+
+	uint32_t RecordingBackend::createList()
+	{
+		record( Op::createList );
+		return ++lastList;
+	}
+
+
+	void RecordingBackend::deleteList( uint32_t list )
+	{
+		record( Op::deleteList, float( list ) );
+	}
+
+
+	void RecordingBackend::beginList( uint32_t list )
+	{
+		record( Op::beginList, float( list ) );
+	}
+
+
+	void RecordingBackend::endList()
+	{
+		record( Op::endList );
+	}
+
+
+	void RecordingBackend::callList( uint32_t list )
+	{
+		record( Op::callList, float( list ) );
+	}
+}
+
+
+//-------------------------------------------------------
+//	state tracking
+//-------------------------------------------------------
+
+namespace Gl
+{
+	namespace
+	{
+		constexpr int matrixModeCount = 2;
+		constexpr int capabilityCount = 1;
+
+
+		struct Matrix
+		{
+			enum class Kind
+			{
+				unknown,
+				identity,
+				orthographic
+			};
+
+			Kind kind = Kind::unknown;
+			// scale x, y and center x, y of an orthographic matrix
+			float orthographic[ 4 ] = {};
+		};
+
+
+		// what the context is known to hold, unknown until first set
+		struct State
+		{
+			int matrixMode = -1;
+			Matrix matrices[ matrixModeCount ];
+			int capabilities[ capabilityCount ] = { -1 };
+			bool hasClearColor = false;
+			float clearColor[ 4 ] = {};
+			bool hasColor = false;
+			float color[ 3 ] = {};
+		};
+
+
+		Backend* backend = nullptr;
+		uint32_t backendContextId = 0;
+		State state;
+		// compiled commands do not execute, the state is restored from here afterwards
+		State compileState;
+		bool isCompiling = false;
+		FrameStats currentFrame;
+		FrameStats previousFrame;
+		int frameBudget = 0;
+
+
+		void count( Category category )
+		{
+			assert( backend );
+			currentFrame.calls[ int( category ) ]++;
+		}
+
+
+		void drop()
+		{
+			currentFrame.dropped++;
+		}
+
+
+		Matrix& currentMatrix()
+		{
+			assert( state.matrixMode >= 0 );
+			return state.matrices[ state.matrixMode ];
+		}
+	}
+
+
+	void setBackend( Backend* newBackend )
+	{
+		assert( !isCompiling );
+		backend = newBackend;
+		backendContextId++;
+		resetState();
+	}
+
+
+	uint32_t contextId()
+	{
+		return backendContextId;
+	}
+
+
+	void resetState()
+	{
+		state = State();
+	}
+
+
+	void beginFrame()
+	{
+		currentFrame = FrameStats();
+	}
+
+
+	void endFrame()
+	{
+		previousFrame = currentFrame;
+	}
+
+
+	FrameStats const& lastFrameStats()
+	{
+		return previousFrame;
+	}
+
+
+	void setFrameBudget( int maxCalls )
+	{
+		frameBudget = maxCalls;
+	}
+
+
+	bool isWithinBudget()
+	{
+		return frameBudget <= 0 || previousFrame.total() <= frameBudget;
+	}
+
+
+	void matrixMode( MatrixMode mode )
+	{
+		assert( !isCompiling );
+		if ( state.matrixMode == int( mode ) )
+			return drop();
+		count( Category::state );
+		backend->matrixMode( mode );
+		state.matrixMode = int( mode );
+	}
+
+
+	void loadIdentity()
+	{
+		Matrix& matrix = currentMatrix();
+		if ( matrix.kind == Matrix::Kind::identity )
+			return drop();
+		count( Category::transform );
+		backend->loadIdentity();
+		matrix.kind = Matrix::Kind::identity;
+	}
+
+
+	void scale( float x, float y, float z )
+	{
+		if ( x == 1.f && y == 1.f && z == 1.f )
+			return drop();
+		count( Category::transform );
+		backend->scale( x, y, z );
+		currentMatrix().kind = Matrix::Kind::unknown;
+	}
+
+
+	void loadOrthographic( float scaleX, float scaleY, float centerX, float centerY )
+	{
+		Matrix& matrix = currentMatrix();
+		float* cached = matrix.orthographic;
+		if ( matrix.kind == Matrix::Kind::orthographic && cached[ 0 ] == scaleX && cached[ 1 ] == scaleY && cached[ 2 ] == centerX && cached[ 3 ] == centerY )
+		{
+			// the identity, scale and translation are all saved
+			currentFrame.dropped += 3;
+			return;
+		}
+		loadIdentity();
+		scale( scaleX, scaleY, 0.f );
+		translate( -centerX, -centerY, 0.f );
+		matrix.kind = Matrix::Kind::orthographic;
+		cached[ 0 ] = scaleX;
+		cached[ 1 ] = scaleY;
+		cached[ 2 ] = centerX;
+		cached[ 3 ] = centerY;
+	}
+
+
+	void translate( float x, float y, float z )
+	{
+		if ( x == 0.f && y == 0.f && z == 0.f )
+			return drop();
+		count( Category::transform );
+		backend->translate( x, y, z );
+		currentMatrix().kind = Matrix::Kind::unknown;
+	}
+
+
+	void rotateZ( float degrees )
+	{
+		if ( degrees == 0.f )
+			return drop();
+		count( Category::transform );
+		backend->rotateZ( degrees );
+		currentMatrix().kind = Matrix::Kind::unknown;
+	}
+
+
+	void setEnabled( Capability capability, bool isEnabled )
+	{
+		assert( !isCompiling );
+		int& cached = state.capabilities[ int( capability ) ];
+		if ( cached == int( isEnabled ) )
+			return drop();
+		count( Category::state );
+		backend->setEnabled( capability, isEnabled );
+		cached = int( isEnabled );
+	}
+
+
+	void clearColor( float r, float g, float b, float a )
+	{
+		assert( !isCompiling );
+		float* cached = state.clearColor;
+		if ( state.hasClearColor && cached[ 0 ] == r && cached[ 1 ] == g && cached[ 2 ] == b && cached[ 3 ] == a )
+			return drop();
+		count( Category::state );
+		backend->clearColor( r, g, b, a );
+		cached[ 0 ] = r;
+		cached[ 1 ] = g;
+		cached[ 2 ] = b;
+		cached[ 3 ] = a;
+		state.hasClearColor = true;
+	}
+
+
+	void clear()
+	{
+		assert( !isCompiling );
+		count( Category::draw );
+		backend->clear();
+	}
+
+
+	void color( float r, float g, float b )
+	{
+		float* cached = state.color;
+		if ( state.hasColor && cached[ 0 ] == r && cached[ 1 ] == g && cached[ 2 ] == b )
+			return drop();
+		count( Category::state );
+		backend->color( r, g, b );
+		cached[ 0 ] = r;
+		cached[ 1 ] = g;
+		cached[ 2 ] = b;
+		state.hasColor = true;
+	}
+
+
+	void begin( Primitive primitive )
+	{
+		count( Category::draw );
+		backend->begin( primitive );
+	}
+
+
+	void vertex( float x, float y )
+	{
+		count( Category::vertex );
+		backend->vertex( x, y );
+	}
+
+
+	void end()
+	{
+		count( Category::draw );
+		backend->end();
+	}
+
+
+	uint32_t createList()
+	{
+		count( Category::state );
+		return backend->createList();
+	}
+
+
+	void deleteList( uint32_t list )
+	{
+		count( Category::state );
+		backend->deleteList( list );
+	}
+
+
+	void beginList( uint32_t list )
+	{
+		assert( !isCompiling );
+		count( Category::draw );
+		backend->beginList( list );
+
+		// nothing may be dropped based on what the context holds outside the list
+		compileState = state;
+		currentMatrix().kind = Matrix::Kind::unknown;
+		state.hasColor = false;
+		isCompiling = true;
+	}
+
+
+	void endList()
+	{
+		assert( isCompiling );
+		count( Category::draw );
+		backend->endList();
+		state = compileState;
+		isCompiling = false;
+	}
+
+
+	void callList( uint32_t list )
+	{
+		assert( !isCompiling );
+		count( Category::draw );
+		backend->callList( list );
+		currentMatrix().kind = Matrix::Kind::unknown;
+		state.hasColor = false;
+	}
+}
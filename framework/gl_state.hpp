@@ -0,0 +1,196 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+
+//-------------------------------------------------------
+//	thin OpenGL wrapper: caches the current state, drops
+//	redundant calls and counts issued calls per frame;
+//	calls go to a backend, which is real OpenGL or a recorder
+//-------------------------------------------------------
+
+namespace Gl
+{
+	enum class MatrixMode
+	{
+		projection,
+		modelview
+	};
+
+
+	enum class Primitive
+	{
+		triangles,
+		triangleStrip,
+		triangleFan
+	};
+
+
+	enum class Capability
+	{
+		cullFace
+	};
+
+
+	enum class Category
+	{
+		state,		// matrix mode, capabilities, colors
+		transform,	// matrix loads and multiplications
+		draw,		// clear, begin/end, display lists
+		vertex,		// immediate mode vertices
+		count
+	};
+
+
+	struct FrameStats
+	{
+		int calls[ int( Category::count ) ] = {};
+		int dropped = 0;
+
+		int total() const;
+	};
+
+
+	//-------------------------------------------------------
+	//	backend interface
+	//-------------------------------------------------------
+
+	class Backend
+	{
+	public:
+		virtual ~Backend();
+
+		virtual void matrixMode( MatrixMode mode ) = 0;
+		virtual void loadIdentity() = 0;
+		virtual void scale( float x, float y, float z ) = 0;
+		virtual void translate( float x, float y, float z ) = 0;
+		virtual void rotateZ( float degrees ) = 0;
+		virtual void setEnabled( Capability capability, bool isEnabled ) = 0;
+		virtual void clearColor( float r, float g, float b, float a ) = 0;
+		virtual void clear() = 0;
+		virtual void color( float r, float g, float b ) = 0;
+		virtual void begin( Primitive primitive ) = 0;
+		virtual void vertex( float x, float y ) = 0;
+		virtual void end() = 0;
+
+		// display lists, compiled without being executed
+		virtual uint32_t createList() = 0;
+		virtual void deleteList( uint32_t list ) = 0;
+		virtual void beginList( uint32_t list ) = 0;
+		virtual void endList() = 0;
+		virtual void callList( uint32_t list ) = 0;
+	};
+
+
+	// issues real OpenGL calls into the context current on the calling thread
+	Backend* openGLBackend();
+
+
+	//-------------------------------------------------------
+	//	mock backend recording every call, no context needed
+	//-------------------------------------------------------
+
+	class RecordingBackend : public Backend
+	{
+	public:
+		enum class Op
+		{
+			matrixMode,
+			loadIdentity,
+			scale,
+			translate,
+			rotateZ,
+			setEnabled,
+			clearColor,
+			clear,
+			color,
+			begin,
+			vertex,
+			end,
+			createList,
+			deleteList,
+			beginList,
+			endList,
+			callList
+		};
+
+		struct Command
+		{
+			Op op;
+			float arguments[ 4 ];
+		};
+
+		void matrixMode( MatrixMode mode ) override;
+		void loadIdentity() override;
+		void scale( float x, float y, float z ) override;
+		void translate( float x, float y, float z ) override;
+		void rotateZ( float degrees ) override;
+		void setEnabled( Capability capability, bool isEnabled ) override;
+		void clearColor( float r, float g, float b, float a ) override;
+		void clear() override;
+		void color( float r, float g, float b ) override;
+		void begin( Primitive primitive ) override;
+		void vertex( float x, float y ) override;
+		void end() override;
+		uint32_t createList() override;
+		void deleteList( uint32_t list ) override;
+		void beginList( uint32_t list ) override;
+		void endList() override;
+		void callList( uint32_t list ) override;
+
+		std::vector< Command > commands;
+
+	private:
+		uint32_t lastList = 0;
+
+		void record( Op op, float a = 0.f, float b = 0.f, float c = 0.f, float d = 0.f );
+	};
+
+
+	//-------------------------------------------------------
+	//	state tracking front end used by the renderer
+	//-------------------------------------------------------
+
+	// also forgets all cached state
+	void setBackend( Backend* backend );
+
+	// changes with every setBackend; objects such as display lists
+	// created under another id are gone
+	uint32_t contextId();
+
+	// call after anything outside this wrapper touched the GL state
+	void resetState();
+
+	// per frame counters, isWithinBudget checks the last frame against the budget if one is set;
+	// the headless engine's --check-budgets fails on a frame over budget
+	void beginFrame();
+	void endFrame();
+	FrameStats const& lastFrameStats();
+	void setFrameBudget( int maxCalls );
+	bool isWithinBudget();
+
+	void matrixMode( MatrixMode mode );
+	void loadIdentity();
+	void scale( float x, float y, float z );
+	// identity, scale with z flattened, then translation by -center;
+	// dropped while the matrix still holds it
+	void loadOrthographic( float scaleX, float scaleY, float centerX, float centerY );
+	void translate( float x, float y, float z );
+	void rotateZ( float degrees );
+	void setEnabled( Capability capability, bool isEnabled );
+	void clearColor( float r, float g, float b, float a );
+	void clear();
+	void color( float r, float g, float b );
+	void begin( Primitive primitive );
+	void vertex( float x, float y );
+	void end();
+
+	// a list may change only the current matrix and the color,
+	// both count as unknown after calling it
+	uint32_t createList();
+	void deleteList( uint32_t list );
+	void beginList( uint32_t list );
+	void endList();
+	void callList( uint32_t list );
+}
@@ -0,0 +1,118 @@
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cmath>
+
+#include "grid.hpp"
+
+
+namespace Grid
+{
+	namespace
+	{
+		int squareColumns( int tableCount )
+		{
+			return std::max( 1, int( std::ceil( std::sqrt( float( tableCount ) ) ) ) );
+		}
+
+
+		Scene::CircleInstance moved( Scene::CircleInstance const& circle, float alpha, float dx, float dy )
+		{
+			const float x = circle.x( alpha ) + dx;
+			const float y = circle.y( alpha ) + dy;
+			const float angle = circle.rotation( alpha );
+			return { x, y, angle, x, y, angle, circle.radius, circle.color };
+		}
+
+
+		Scene::RectangleInstance moved( Scene::RectangleInstance const& rectangle, float dx, float dy )
+		{
+			return { rectangle.left + dx, rectangle.top + dy, rectangle.right + dx, rectangle.bottom + dy, rectangle.color };
+		}
+
+
+		// far above the versions Scene gives a single table's layer, which start at 1,
+		// so a cache that saw both never confuses them
+		std::atomic< uint32_t > nextStaticVersion = { 0x80000000u };
+	}
+
+
+	Layout::Layout( int tableCount, int columns ) :
+		tableCount( tableCount ),
+		columns( columns > 0 ? columns : squareColumns( tableCount ) ),
+		rows( std::max( 1, ( tableCount + this->columns - 1 ) / this->columns ) )
+	{
+	}
+
+
+	float Layout::cellX( int table ) const
+	{
+		return ( float( table % columns ) - 0.5f * float( columns - 1 ) ) * Scene::View::width;
+	}
+
+
+	float Layout::cellY( int table ) const
+	{
+		return ( 0.5f * float( rows - 1 ) - float( table / columns ) ) * Scene::View::height;
+	}
+
+
+	Scene::Camera Layout::overview() const
+	{
+		Scene::Camera camera;
+		camera.zoom = 1.f / float( std::max( columns, rows ) );
+		return camera;
+	}
+
+
+	int Composer::compose( std::vector< Scene::Frame const* > const& tables, Layout const& layout, Scene::Camera const& camera, Scene::Frame& target )
+	{
+		assert( int( tables.size() ) <= layout.tableCount );
+
+		target.staticCircles.clear();
+		target.staticRectangles.clear();
+		target.circles.clear();
+		target.rectangles.clear();
+		target.camera = camera;
+		target.interpolation = 1.f;
+		target.traceId = 0;
+		if ( !tables.empty() )
+			target.clearColor = tables.front()->clearColor;
+
+		const float cellHalfWidth = 0.5f * Scene::View::width;
+		const float cellHalfHeight = 0.5f * Scene::View::height;
+
+		composedSources.clear();
+		composedSources.push_back( uint32_t( layout.columns ) );
+		int composed = 0;
+		for ( int table = 0; table < int( tables.size() ); table++ )
+		{
+			const float dx = layout.cellX( table );
+			const float dy = layout.cellY( table );
+			if ( std::abs( dx - camera.centerX ) > cellHalfWidth + camera.halfWidth() || std::abs( dy - camera.centerY ) > cellHalfHeight + camera.halfHeight() )
+				continue;
+
+			Scene::Frame const& frame = *tables[ table ];
+			for ( Scene::CircleInstance const& circle : frame.staticCircles )
+				target.staticCircles.push_back( moved( circle, 1.f, dx, dy ) );
+			for ( Scene::RectangleInstance const& rectangle : frame.staticRectangles )
+				target.staticRectangles.push_back( moved( rectangle, dx, dy ) );
+			for ( Scene::CircleInstance const& circle : frame.circles )
+				target.circles.push_back( moved( circle, frame.interpolation, dx, dy ) );
+			for ( Scene::RectangleInstance const& rectangle : frame.rectangles )
+				target.rectangles.push_back( moved( rectangle, dx, dy ) );
+
+			composedSources.push_back( uint32_t( table ) );
+			composedSources.push_back( frame.staticVersion );
+			composed++;
+		}
+
+		if ( staticVersion == 0 || composedSources != sources )
+		{
+			staticVersion = nextStaticVersion.fetch_add( 1, std::memory_order_relaxed );
+			sources.swap( composedSources );
+		}
+		target.staticVersion = staticVersion;
+		return composed;
+	}
+}
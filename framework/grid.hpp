@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "frame.hpp"
+
+
+//-------------------------------------------------------
+//	grid view: many independent tables side by side in one
+//	frame, so any renderer draws them in a single pass
+//-------------------------------------------------------
+
+namespace Grid
+{
+	// every table gets a View::width by View::height cell, row by row from the top left
+	class Layout
+	{
+	public:
+		// columns <= 0 picks a near square grid
+		explicit Layout( int tableCount, int columns = 0 );
+
+		// world center of a table's cell
+		float cellX( int table ) const;
+		float cellY( int table ) const;
+
+		// camera showing the whole grid
+		Scene::Camera overview() const;
+
+		int const tableCount;
+		int const columns;
+		int const rows;
+	};
+
+
+	// remembers what its last frame was made of: the composed static layer gets a new
+	// version, from a counter shared by all composers, exactly when a visible table's
+	// static layer or the set of visible tables changed, so static layer caches keyed
+	// on the version never mistake one layer for another
+	class Composer
+	{
+	public:
+		// copies the tables whose cells the camera sees into target, moved to their cells
+		// and with transforms resolved at each table's own interpolation; tables outside
+		// the camera cost nothing; returns how many were composed
+		int compose( std::vector< Scene::Frame const* > const& tables, Layout const& layout, Scene::Camera const& camera, Scene::Frame& target );
+
+	private:
+		// the layout's columns, then index and static version of every composed table
+		std::vector< uint32_t > sources;
+		std::vector< uint32_t > composedSources;
+		uint32_t staticVersion = 0;
+	};
+}
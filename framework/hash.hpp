@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+
+//-------------------------------------------------------
+//	64 bit hashing shared by the table hashes and the
+//	shot cache keys
+//-------------------------------------------------------
+
+namespace Hash
+{
+	// the splitmix64 finalizer: every input bit reaches every output bit,
+	// so any slice of the result, the top bits say, is as good as the rest
+	inline uint64_t finalize( uint64_t x )
+	{
+		x = ( x ^ ( x >> 30 ) ) * 0xbf58476d1ce4e5b9ull;
+		x = ( x ^ ( x >> 27 ) ) * 0x94d049bb133111ebull;
+		return x ^ ( x >> 31 );
+	}
+
+
+	// folds one more value into a running hash, order matters
+	inline uint64_t mix( uint64_t hash, uint64_t value )
+	{
+		return finalize( hash ^ ( value + 0x9e3779b97f4a7c15ull + ( hash << 6 ) + ( hash >> 2 ) ) );
+	}
+
+
+	// a float as stored, so hashes tell apart exactly the values they were given
+	inline uint32_t floatBits( float value )
+	{
+		uint32_t bits = 0;
+		std::memcpy( &bits, &value, sizeof( bits ) );
+		return bits;
+	}
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstdint>
+
+
+//-------------------------------------------------------
+//	timestamped platform input, applied by the game at a fixed step
+//-------------------------------------------------------
+
+namespace Input
+{
+	enum class Type : uint8_t
+	{
+		mouseButtonPressed,
+		mouseButtonReleased,
+		restart
+	};
+
+
+	struct Event
+	{
+		Type type;
+		uint32_t id;
+		// world coordinates for mouse events
+		float x;
+		float y;
+		// Clock::now() when the platform delivered the event
+		double timestamp;
+	};
+}
@@ -0,0 +1,164 @@
+#include <atomic>
+#include <cmath>
+#include <fstream>
+
+#include "clock.hpp"
+#include "latency.hpp"
+
+
+namespace Latency
+{
+	namespace
+	{
+		constexpr int stageCount = int( Stage::count );
+
+		// log scale histogram, four buckets per octave starting at 1us
+		constexpr int bucketsPerOctave = 4;
+		constexpr int bucketCount = 24 * bucketsPerOctave;
+
+		std::atomic< uint32_t > histogram[ stageCount ][ bucketCount ];
+
+
+		// traces are kept in a small ring, a slot is reused by a newer id;
+		// begin runs on the input thread while mark may read the same slot on the
+		// render thread, so a mark re-checks the id after reading the timestamp
+		constexpr uint32_t traceCount = 256;
+
+		struct Trace
+		{
+			std::atomic< uint32_t > id = { 0 };
+			std::atomic< uint8_t > recordedStages = { 0 };
+			std::atomic< double > acquired = { 0.0 };
+		};
+
+		Trace traces[ traceCount ];
+
+		char const* const stageNames[ stageCount ] = { "applied", "simulated", "drawn", "presented" };
+
+		double ( *timeSource )() = Clock::now;
+
+
+		int bucketIndex( double seconds )
+		{
+			const double microseconds = seconds * 1e6;
+			if ( microseconds < 1.0 )
+				return 0;
+			const int index = int( std::log2( microseconds ) * bucketsPerOctave );
+			return index < bucketCount ? index : bucketCount - 1;
+		}
+
+
+		double bucketUpperBound( int index )
+		{
+			return std::exp2( double( index + 1 ) / bucketsPerOctave ) * 1e-6;
+		}
+
+
+		double bucketLowerBound( int index )
+		{
+			return index == 0 ? 0.0 : std::exp2( double( index ) / bucketsPerOctave ) * 1e-6;
+		}
+	}
+
+
+	void setTimeSource( double ( *now )() )
+	{
+		timeSource = now;
+	}
+
+
+	void begin( uint32_t id, double timestamp )
+	{
+		Trace& trace = traces[ id % traceCount ];
+		trace.id.store( 0, std::memory_order_relaxed );
+		std::atomic_thread_fence( std::memory_order_release );
+		trace.acquired.store( timestamp, std::memory_order_relaxed );
+		trace.recordedStages.store( 0, std::memory_order_relaxed );
+		trace.id.store( id, std::memory_order_release );
+	}
+
+
+	void mark( uint32_t id, Stage stage )
+	{
+		mark( id, stage, timeSource() );
+	}
+
+
+	void mark( uint32_t id, Stage stage, double timestamp )
+	{
+		if ( id == 0 )
+			return;
+
+		Trace& trace = traces[ id % traceCount ];
+		if ( trace.id.load( std::memory_order_acquire ) != id )
+			return;
+		const double acquired = trace.acquired.load( std::memory_order_relaxed );
+		std::atomic_thread_fence( std::memory_order_acquire );
+		// a newer id took the slot while the timestamp was read
+		if ( trace.id.load( std::memory_order_relaxed ) != id )
+			return;
+
+		const uint8_t stageBit = uint8_t( 1 << int( stage ) );
+		if ( trace.recordedStages.fetch_or( stageBit, std::memory_order_relaxed ) & stageBit )
+			return;
+
+		histogram[ int( stage ) ][ bucketIndex( timestamp - acquired ) ].fetch_add( 1, std::memory_order_relaxed );
+	}
+
+
+	int sampleCount( Stage stage )
+	{
+		int count = 0;
+		for ( auto const& bucket : histogram[ int( stage ) ] )
+			count += int( bucket.load( std::memory_order_relaxed ) );
+		return count;
+	}
+
+
+	double percentile( Stage stage, double fraction )
+	{
+		const int total = sampleCount( stage );
+		if ( total == 0 )
+			return 0.0;
+
+		const double threshold = fraction * total;
+		int accumulated = 0;
+		for ( int i = 0; i < bucketCount; i++ )
+		{
+			accumulated += int( histogram[ int( stage ) ][ i ].load( std::memory_order_relaxed ) );
+			if ( accumulated >= threshold )
+				return bucketUpperBound( i );
+		}
+		return bucketUpperBound( bucketCount - 1 );
+	}
+
+
+	bool exportCsv( char const* path )
+	{
+		std::ofstream file( path );
+		if ( !file )
+			return false;
+
+		file << "stage,lower_us,upper_us,count\n";
+		for ( int stage = 0; stage < stageCount; stage++ )
+		{
+			for ( int i = 0; i < bucketCount; i++ )
+			{
+				const uint32_t count = histogram[ stage ][ i ].load( std::memory_order_relaxed );
+				if ( count )
+					file << stageNames[ stage ] << ',' << bucketLowerBound( i ) * 1e6 << ',' << bucketUpperBound( i ) * 1e6 << ',' << count << '\n';
+			}
+		}
+		return bool( file );
+	}
+
+
+	void reset()
+	{
+		for ( auto& stage : histogram )
+			for ( auto& bucket : stage )
+				bucket.store( 0, std::memory_order_relaxed );
+		for ( Trace& trace : traces )
+			trace.id.store( 0, std::memory_order_relaxed );
+	}
+}
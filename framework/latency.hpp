@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstdint>
+
+
+//-------------------------------------------------------
+//	input-to-photon latency tracing
+//
+//	every input event opens a trace under its id, later stages
+//	record the time elapsed since the event was acquired;
+//	each stage is recorded at most once per trace
+//-------------------------------------------------------
+
+namespace Latency
+{
+	enum class Stage
+	{
+		applied,	// game consumed the event
+		simulated,	// first step that moved the cue ball
+		drawn,		// scene submitted to the graphics api
+		presented,	// buffers swapped
+		count
+	};
+
+
+	// clock used by mark() without timestamp, Clock::now() by default
+	void setTimeSource( double ( *now )() );
+
+	void begin( uint32_t id, double timestamp );
+	void mark( uint32_t id, Stage stage );
+	void mark( uint32_t id, Stage stage, double timestamp );
+
+	// latency in seconds below which the given fraction of samples fall
+	double percentile( Stage stage, double fraction );
+	int sampleCount( Stage stage );
+
+	// one row per non-empty histogram bucket: stage, lower and upper bound in microseconds, count
+	bool exportCsv( char const* path );
+
+	void reset();
+}
@@ -0,0 +1,327 @@
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+
+#if defined( __AVX__ )
+#include <immintrin.h>
+#elif defined( __SSE2__ ) || defined( _M_X64 ) || ( defined( _M_IX86_FP ) && _M_IX86_FP >= 2 )
+#include <emmintrin.h>
+#define RASTER_SSE2
+#endif
+
+#include "raster.hpp"
+
+
+namespace Raster
+{
+	namespace
+	{
+		uint32_t packColor( Scene::Rgb const& color )
+		{
+			auto channel = []( float value ) -> uint32_t
+			{
+				return uint32_t( std::max( 0.f, std::min( value, 1.f ) ) * 255.f + 0.5f );
+			};
+			return channel( color.r ) | channel( color.g ) << 8 | channel( color.b ) << 16 | 0xff000000u;
+		}
+
+
+		// [begin, end) of one row
+		void fillSpan( uint32_t* row, int begin, int end, uint32_t color )
+		{
+			int x = begin;
+#if defined( __AVX__ )
+			const __m256i value = _mm256_set1_epi32( int( color ) );
+			for ( ; x + 8 <= end; x += 8 )
+				_mm256_storeu_si256( reinterpret_cast< __m256i* >( row + x ), value );
+#elif defined( RASTER_SSE2 )
+			const __m128i value = _mm_set1_epi32( int( color ) );
+			for ( ; x + 4 <= end; x += 4 )
+				_mm_storeu_si128( reinterpret_cast< __m128i* >( row + x ), value );
+#endif
+			for ( ; x < end; x++ )
+				row[ x ] = color;
+		}
+
+
+		// first pixel whose center lies at or after the given coordinate
+		int pixelFrom( float coordinate, int lower, int upper )
+		{
+			return std::max( lower, std::min( int( std::ceil( coordinate - 0.5f ) ), upper ) );
+		}
+
+
+		// pixel rectangle [x0, x1) x [y0, y1) primitives are clipped to
+		struct Region
+		{
+			int x0;
+			int y0;
+			int x1;
+			int y1;
+		};
+
+
+		class Mapping
+		{
+		public:
+			Mapping( Framebuffer const& target, Scene::Camera const& camera ) :
+				scaleX( float( target.width ) / ( 2.f * camera.halfWidth() ) ),
+				scaleY( float( target.height ) / ( 2.f * camera.halfHeight() ) ),
+				left( camera.centerX - camera.halfWidth() ),
+				top( camera.centerY + camera.halfHeight() )
+			{
+			}
+
+			float x( float worldX ) const { return ( worldX - left ) * scaleX; }
+			float y( float worldY ) const { return ( top - worldY ) * scaleY; }
+
+			float const scaleX;
+			float const scaleY;
+			// world coordinates of the top left pixel corner
+			float const left;
+			float const top;
+		};
+
+
+		void fillRectangle( Framebuffer& target, Region const& clip, Mapping const& mapping, Scene::RectangleInstance const& rectangle )
+		{
+			const float left = mapping.x( std::min( rectangle.left, rectangle.right ) );
+			const float right = mapping.x( std::max( rectangle.left, rectangle.right ) );
+			const float top = mapping.y( std::max( rectangle.top, rectangle.bottom ) );
+			const float bottom = mapping.y( std::min( rectangle.top, rectangle.bottom ) );
+
+			const int x0 = pixelFrom( left, clip.x0, clip.x1 );
+			const int x1 = pixelFrom( right, clip.x0, clip.x1 );
+			const int y0 = pixelFrom( top, clip.y0, clip.y1 );
+			const int y1 = pixelFrom( bottom, clip.y0, clip.y1 );
+			const uint32_t color = packColor( rectangle.color );
+
+			for ( int y = y0; y < y1; y++ )
+				fillSpan( &target.pixels[ size_t( y ) * target.width ], x0, x1, color );
+		}
+
+
+		void fillCircle( Framebuffer& target, Region const& clip, Mapping const& mapping, Scene::CircleInstance const& circle, float alpha )
+		{
+			const float centerX = mapping.x( circle.x( alpha ) );
+			const float centerY = mapping.y( circle.y( alpha ) );
+			const float radiusX = circle.radius * mapping.scaleX;
+			const float radiusY = circle.radius * mapping.scaleY;
+
+			const int y0 = pixelFrom( centerY - radiusY, clip.y0, clip.y1 );
+			const int y1 = pixelFrom( centerY + radiusY, clip.y0, clip.y1 );
+			const uint32_t color = packColor( circle.color );
+
+			for ( int y = y0; y < y1; y++ )
+			{
+				const float dy = ( float( y ) + 0.5f - centerY ) / radiusY;
+				const float rest = 1.f - dy * dy;
+				if ( rest <= 0.f )
+					continue;
+
+				const float halfSpan = radiusX * std::sqrt( rest );
+				fillSpan( &target.pixels[ size_t( y ) * target.width ],
+					pixelFrom( centerX - halfSpan, clip.x0, clip.x1 ), pixelFrom( centerX + halfSpan, clip.x0, clip.x1 ), color );
+			}
+		}
+
+
+		void fillStaticLayer( Framebuffer& target, Region const& clip, Mapping const& mapping, Scene::Frame const& frame )
+		{
+			// static circles are never interpolated
+			for ( Scene::CircleInstance const& circle : frame.staticCircles )
+				fillCircle( target, clip, mapping, circle, 1.f );
+			for ( Scene::RectangleInstance const& rectangle : frame.staticRectangles )
+				fillRectangle( target, clip, mapping, rectangle );
+		}
+
+
+		void fillDynamicLayer( Framebuffer& target, Region const& clip, Mapping const& mapping, Scene::Frame const& frame )
+		{
+			for ( Scene::CircleInstance const& circle : frame.circles )
+				fillCircle( target, clip, mapping, circle, frame.interpolation );
+			for ( Scene::RectangleInstance const& rectangle : frame.rectangles )
+				fillRectangle( target, clip, mapping, rectangle );
+		}
+	}
+
+
+	Framebuffer::Framebuffer( int width, int height ) :
+		width( width ),
+		height( height ),
+		pixels( size_t( width ) * height )
+	{
+	}
+
+
+	bool Framebuffer::savePpm( char const* path ) const
+	{
+		std::ofstream file( path, std::ios::binary );
+		if ( !file )
+			return false;
+
+		file << "P6\n" << width << ' ' << height << "\n255\n";
+		std::vector< char > row( size_t( width ) * 3 );
+		for ( int y = 0; y < height; y++ )
+		{
+			for ( int x = 0; x < width; x++ )
+			{
+				const uint32_t pixel = pixels[ size_t( y ) * width + x ];
+				row[ x * 3 + 0 ] = char( pixel & 0xff );
+				row[ x * 3 + 1 ] = char( pixel >> 8 & 0xff );
+				row[ x * 3 + 2 ] = char( pixel >> 16 & 0xff );
+			}
+			file.write( row.data(), std::streamsize( row.size() ) );
+		}
+		return bool( file );
+	}
+
+
+	void StaticLayer::update( Scene::Frame const& frame, int layerWidth, int layerHeight )
+	{
+		const uint32_t layerClearColor = packColor( frame.clearColor );
+		Scene::Camera const& view = frame.camera;
+		if ( isValid && version == frame.staticVersion && clearColor == layerClearColor && width == layerWidth && height == layerHeight &&
+			camera.centerX == view.centerX && camera.centerY == view.centerY && camera.zoom == view.zoom )
+			return;
+
+		Framebuffer layer( layerWidth, layerHeight );
+		fillSpan( layer.pixels.data(), 0, int( layer.pixels.size() ), layerClearColor );
+		fillStaticLayer( layer, { 0, 0, layerWidth, layerHeight }, Mapping( layer, frame.camera ), frame );
+
+		runs.clear();
+		rowRuns.clear();
+		for ( int y = 0; y < layerHeight; y++ )
+		{
+			rowRuns.push_back( uint32_t( runs.size() ) );
+			uint32_t const* row = &layer.pixels[ size_t( y ) * layerWidth ];
+			for ( int x = 0; x < layerWidth; )
+			{
+				const int begin = x;
+				while ( x < layerWidth && row[ x ] == row[ begin ] )
+					x++;
+				runs.push_back( { begin, x, row[ begin ] } );
+			}
+		}
+		rowRuns.push_back( uint32_t( runs.size() ) );
+
+		isValid = true;
+		version = frame.staticVersion;
+		clearColor = layerClearColor;
+		camera = view;
+		width = layerWidth;
+		height = layerHeight;
+	}
+
+
+	void StaticLayer::fill( Framebuffer& target, int x0, int y0, int x1, int y1 ) const
+	{
+		for ( int y = y0; y < y1; y++ )
+		{
+			uint32_t* row = &target.pixels[ size_t( y ) * target.width ];
+			for ( uint32_t i = rowRuns[ y ]; i < rowRuns[ y + 1 ]; i++ )
+			{
+				Run const& run = runs[ i ];
+				if ( run.end <= x0 )
+					continue;
+				if ( run.begin >= x1 )
+					break;
+				fillSpan( row, std::max( run.begin, x0 ), std::min( run.end, x1 ), run.color );
+			}
+		}
+	}
+
+
+	void render( Scene::Frame const& frame, Framebuffer& target )
+	{
+		const Mapping mapping( target, frame.camera );
+		const Region clip = { 0, 0, target.width, target.height };
+
+		fillSpan( target.pixels.data(), 0, int( target.pixels.size() ), packColor( frame.clearColor ) );
+		fillStaticLayer( target, clip, mapping, frame );
+		fillDynamicLayer( target, clip, mapping, frame );
+	}
+
+
+	void render( Scene::Frame const& frame, Framebuffer& target, StaticLayer& cache )
+	{
+		cache.update( frame, target.width, target.height );
+		cache.fill( target, 0, 0, target.width, target.height );
+		fillDynamicLayer( target, { 0, 0, target.width, target.height }, Mapping( target, frame.camera ), frame );
+	}
+
+
+	TiledRenderer::TiledRenderer( ThreadPool& pool, int tileSize ) :
+		pool( pool ),
+		tileSize( tileSize )
+	{
+	}
+
+
+	void TiledRenderer::render( Scene::Frame const& frame, Framebuffer& target )
+	{
+		const Mapping mapping( target, frame.camera );
+		staticLayer.update( frame, target.width, target.height );
+		const int tilesX = ( target.width + tileSize - 1 ) / tileSize;
+		const int tilesY = ( target.height + tileSize - 1 ) / tileSize;
+
+		tiles.resize( size_t( tilesX ) * tilesY );
+		for ( Tile& tile : tiles )
+		{
+			tile.circles.clear();
+			tile.rectangles.clear();
+		}
+
+		// bin primitives by their pixel bounds, keeping submission order within a tile
+		auto bin = [ & ]( float left, float top, float right, float bottom, std::vector< uint32_t > Tile::* list, uint32_t index )
+		{
+			const int tx0 = std::max( 0, int( std::floor( left ) ) / tileSize );
+			const int ty0 = std::max( 0, int( std::floor( top ) ) / tileSize );
+			const int tx1 = std::min( tilesX - 1, int( std::floor( right ) ) / tileSize );
+			const int ty1 = std::min( tilesY - 1, int( std::floor( bottom ) ) / tileSize );
+			for ( int ty = ty0; ty <= ty1; ty++ )
+				for ( int tx = tx0; tx <= tx1; tx++ )
+					( tiles[ size_t( ty ) * tilesX + tx ].*list ).push_back( index );
+		};
+
+		for ( uint32_t i = 0; i < frame.circles.size(); i++ )
+		{
+			Scene::CircleInstance const& circle = frame.circles[ i ];
+			const float centerX = mapping.x( circle.x( frame.interpolation ) );
+			const float centerY = mapping.y( circle.y( frame.interpolation ) );
+			const float radiusX = circle.radius * mapping.scaleX;
+			const float radiusY = circle.radius * mapping.scaleY;
+			if ( centerX + radiusX < 0.f || centerY + radiusY < 0.f || centerX - radiusX > target.width || centerY - radiusY > target.height )
+				continue;
+			bin( centerX - radiusX, centerY - radiusY, centerX + radiusX, centerY + radiusY, &Tile::circles, i );
+		}
+
+		for ( uint32_t i = 0; i < frame.rectangles.size(); i++ )
+		{
+			Scene::RectangleInstance const& rectangle = frame.rectangles[ i ];
+			const float left = mapping.x( std::min( rectangle.left, rectangle.right ) );
+			const float right = mapping.x( std::max( rectangle.left, rectangle.right ) );
+			const float top = mapping.y( std::max( rectangle.top, rectangle.bottom ) );
+			const float bottom = mapping.y( std::min( rectangle.top, rectangle.bottom ) );
+			if ( right < 0.f || bottom < 0.f || left > target.width || top > target.height )
+				continue;
+			bin( left, top, right, bottom, &Tile::rectangles, i );
+		}
+
+		pool.parallelFor( int( tiles.size() ), [ & ]( int index )
+		{
+			Tile const& tile = tiles[ index ];
+			const int tx = index % tilesX;
+			const int ty = index / tilesX;
+			const Region clip = { tx * tileSize, ty * tileSize, std::min( ( tx + 1 ) * tileSize, target.width ), std::min( ( ty + 1 ) * tileSize, target.height ) };
+
+			staticLayer.fill( target, clip.x0, clip.y0, clip.x1, clip.y1 );
+
+			// empty tiles are done after the static layer
+			for ( uint32_t circle : tile.circles )
+				fillCircle( target, clip, mapping, frame.circles[ circle ], frame.interpolation );
+			for ( uint32_t rectangle : tile.rectangles )
+				fillRectangle( target, clip, mapping, frame.rectangles[ rectangle ] );
+		} );
+	}
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "frame.hpp"
+#include "thread_pool.hpp"
+
+
+//-------------------------------------------------------
+//	software rasterizer: draws a frame snapshot into memory,
+//	no graphics context required
+//-------------------------------------------------------
+
+namespace Raster
+{
+	class Framebuffer
+	{
+	public:
+		Framebuffer( int width, int height );
+
+		// binary PPM, alpha is dropped
+		bool savePpm( char const* path ) const;
+
+		int const width;
+		int const height;
+		// RGBA8, first row is the top of the view
+		std::vector< uint32_t > pixels;
+	};
+
+
+	//-------------------------------------------------------
+	//	clear color and static layer of a frame, rasterized once into
+	//	runs of equal color per row and reused until the static version,
+	//	clear color, camera or size changes; filling the runs writes every pixel
+	//	exactly once, cheaper than clearing and overdrawing
+	//-------------------------------------------------------
+
+	class StaticLayer
+	{
+	public:
+		void update( Scene::Frame const& frame, int width, int height );
+
+		// writes columns [x0, x1) of rows [y0, y1)
+		void fill( Framebuffer& target, int x0, int y0, int x1, int y1 ) const;
+
+	private:
+		struct Run
+		{
+			int begin;
+			int end;
+			uint32_t color;
+		};
+
+		std::vector< Run > runs;
+		// first run of every row, plus the end of the last row
+		std::vector< uint32_t > rowRuns;
+
+		bool isValid = false;
+		uint32_t version = 0;
+		uint32_t clearColor = 0;
+		Scene::Camera camera;
+		int width = 0;
+		int height = 0;
+	};
+
+
+	void render( Scene::Frame const& frame, Framebuffer& target );
+
+	// same output, the static layer is copied from the cache instead of drawn
+	void render( Scene::Frame const& frame, Framebuffer& target, StaticLayer& cache );
+
+
+	//-------------------------------------------------------
+	//	splits the framebuffer into tiles, bins primitives per tile
+	//	and rasterizes tiles in parallel; output matches render()
+	//-------------------------------------------------------
+
+	class TiledRenderer
+	{
+	public:
+		explicit TiledRenderer( ThreadPool& pool, int tileSize = 64 );
+		TiledRenderer( TiledRenderer const& ) = delete;
+
+		void render( Scene::Frame const& frame, Framebuffer& target );
+
+	private:
+		struct Tile
+		{
+			// indices into the frame's primitive lists
+			std::vector< uint32_t > circles;
+			std::vector< uint32_t > rectangles;
+		};
+
+		ThreadPool& pool;
+		int const tileSize;
+		std::vector< Tile > tiles;
+		StaticLayer staticLayer;
+	};
+}
@@ -0,0 +1,336 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#include "clock.hpp"
+#include "replay.hpp"
+
+
+namespace Replay
+{
+	namespace
+	{
+		constexpr char magic[ 4 ] = { 'M', 'B', 'R', 'P' };
+		constexpr uint32_t version = 1;
+		// a couple of seconds of frames; past that the disk can't keep up and frames are dropped
+		constexpr size_t maxQueuedRecords = 120;
+
+
+		template< class T >
+		void writeValue( std::ofstream& file, T const& value )
+		{
+			file.write( reinterpret_cast< char const* >( &value ), sizeof( value ) );
+		}
+
+
+		template< class T >
+		bool readValue( std::ifstream& file, T& value )
+		{
+			return bool( file.read( reinterpret_cast< char* >( &value ), sizeof( value ) ) );
+		}
+
+
+		// instances are plain floats, stored as they are laid out in memory
+		template< class T >
+		void writeArray( std::ofstream& file, std::vector< T > const& items )
+		{
+			writeValue( file, uint32_t( items.size() ) );
+			file.write( reinterpret_cast< char const* >( items.data() ), std::streamsize( items.size() * sizeof( T ) ) );
+		}
+
+
+		// no more than the file holds past the count, whatever the count says
+		template< class T >
+		bool readCount( std::ifstream& file, std::streamoff fileSize, uint32_t& count )
+		{
+			if ( !readValue( file, count ) )
+				return false;
+			const std::streamoff position = file.tellg();
+			return position >= 0 && uint64_t( count ) * sizeof( T ) <= uint64_t( fileSize - position );
+		}
+
+
+		template< class T >
+		bool readArray( std::ifstream& file, std::streamoff fileSize, std::vector< T >& items )
+		{
+			uint32_t count = 0;
+			if ( !readCount< T >( file, fileSize, count ) )
+				return false;
+			items.resize( count );
+			return bool( file.read( reinterpret_cast< char* >( items.data() ), std::streamsize( count * sizeof( T ) ) ) );
+		}
+
+
+		template< class T >
+		bool skipArray( std::ifstream& file, std::streamoff fileSize )
+		{
+			uint32_t count = 0;
+			if ( !readCount< T >( file, fileSize, count ) )
+				return false;
+			return bool( file.seekg( std::streamoff( count * sizeof( T ) ), std::ios::cur ) );
+		}
+
+
+		std::streamoff sizeOf( std::ifstream& file )
+		{
+			file.seekg( 0, std::ios::end );
+			const std::streamoff size = file.tellg();
+			file.seekg( 0, std::ios::beg );
+			return size;
+		}
+	}
+
+
+	Writer::~Writer()
+	{
+		close();
+	}
+
+
+	bool Writer::open( char const* path, int framesPerSecond, double ( *timeSource )() )
+	{
+		close();
+		file.open( path, std::ios::binary );
+		if ( !file )
+			return false;
+
+		now = timeSource ? timeSource : Clock::now;
+		startTime = now();
+		hasStaticLayer = false;
+		droppedRecords = 0;
+		file.write( magic, sizeof( magic ) );
+		writeValue( file, version );
+		writeValue( file, uint32_t( framesPerSecond ) );
+		if ( !file )
+			return false;
+
+		isClosing = false;
+		worker = std::thread( &Writer::writeLoop, this );
+		return true;
+	}
+
+
+	void Writer::close()
+	{
+		if ( worker.joinable() )
+		{
+			{
+				std::lock_guard< std::mutex > lock( mutex );
+				isClosing = true;
+			}
+			hasRecords.notify_one();
+			worker.join();
+		}
+		file.close();
+	}
+
+
+	bool Writer::isOpen() const
+	{
+		return file.is_open();
+	}
+
+
+	// copies into a written record's lists where there is one, which rarely allocates;
+	// the static layer goes along only when it changed; with the queue full the frame
+	// is dropped rather than the simulation held up, the previous one stays on screen
+	void Writer::write( Scene::Frame const& frame )
+	{
+		std::unique_lock< std::mutex > lock( mutex );
+		if ( queue.size() >= maxQueuedRecords )
+		{
+			droppedRecords++;
+			// the next frame written carries the static layer, whatever this one changed
+			hasStaticLayer = false;
+			return;
+		}
+
+		const bool isStaticLayerChanged = !hasStaticLayer || frame.staticVersion != staticVersion;
+		hasStaticLayer = true;
+		staticVersion = frame.staticVersion;
+		const double time = now() - startTime;
+
+		Record record;
+		if ( !spare.empty() )
+		{
+			record = std::move( spare.back() );
+			spare.pop_back();
+		}
+		lock.unlock();
+
+		record.frame.clearColor = frame.clearColor;
+		record.frame.camera = frame.camera;
+		record.frame.interpolation = frame.interpolation;
+		record.frame.circles = frame.circles;
+		record.frame.rectangles = frame.rectangles;
+		record.isStaticLayerChanged = isStaticLayerChanged;
+		record.time = time;
+		if ( isStaticLayerChanged )
+		{
+			record.frame.staticCircles = frame.staticCircles;
+			record.frame.staticRectangles = frame.staticRectangles;
+		}
+
+		lock.lock();
+		queue.push_back( std::move( record ) );
+		lock.unlock();
+		hasRecords.notify_one();
+	}
+
+
+	void Writer::writeLoop()
+	{
+		std::unique_lock< std::mutex > lock( mutex );
+		for ( ;; )
+		{
+			hasRecords.wait( lock, [ this ] { return !queue.empty() || isClosing; } );
+			if ( queue.empty() )
+				return;
+
+			Record record = std::move( queue.front() );
+			queue.pop_front();
+			const int dropped = droppedRecords;
+			droppedRecords = 0;
+			lock.unlock();
+			if ( dropped > 0 )
+				std::fprintf( stderr, "replay: writing fell behind, %d frames dropped\n", dropped );
+			writeRecord( record );
+			lock.lock();
+			spare.push_back( std::move( record ) );
+		}
+	}
+
+
+	void Writer::writeRecord( Record const& record )
+	{
+		Scene::Frame const& frame = record.frame;
+		writeValue( file, frame.clearColor );
+		writeValue( file, frame.camera );
+		writeValue( file, frame.interpolation );
+		writeValue( file, record.time );
+
+		writeValue( file, uint8_t( record.isStaticLayerChanged ) );
+		if ( record.isStaticLayerChanged )
+		{
+			writeArray( file, frame.staticCircles );
+			writeArray( file, frame.staticRectangles );
+		}
+
+		writeArray( file, frame.circles );
+		writeArray( file, frame.rectangles );
+	}
+
+
+	double Sequence::duration() const
+	{
+		return times.empty() ? 0.0 : times.back();
+	}
+
+
+	size_t Sequence::frameAt( double time ) const
+	{
+		const size_t next = size_t( std::upper_bound( times.begin(), times.end(), time ) - times.begin() );
+		return next > 0 ? next - 1 : 0;
+	}
+
+
+	bool load( char const* path, Sequence& sequence )
+	{
+		std::ifstream file( path, std::ios::binary );
+		const std::streamoff fileSize = sizeOf( file );
+
+		char fileMagic[ 4 ];
+		uint32_t fileVersion = 0;
+		uint32_t framesPerSecond = 0;
+		if ( !file.read( fileMagic, sizeof( fileMagic ) ) || std::memcmp( fileMagic, magic, sizeof( magic ) ) != 0 )
+			return false;
+		if ( !readValue( file, fileVersion ) || fileVersion != version || !readValue( file, framesPerSecond ) )
+			return false;
+
+		sequence.path = path;
+		sequence.framesPerSecond = int( framesPerSecond );
+		sequence.times.clear();
+		sequence.offsets.clear();
+		sequence.frameStaticLayers.clear();
+		sequence.staticLayers.clear();
+
+		for ( ;; )
+		{
+			const std::streamoff offset = file.tellg();
+			Scene::Rgb clearColor;
+			if ( !readValue( file, clearColor ) )
+				break;
+
+			Scene::Camera camera;
+			float interpolation = 0.f;
+			double time = 0.0;
+			uint8_t isStaticLayerChanged = 0;
+			if ( !readValue( file, camera ) || !readValue( file, interpolation ) || !readValue( file, time ) ||
+				!readValue( file, isStaticLayerChanged ) )
+				return false;
+			if ( isStaticLayerChanged )
+			{
+				sequence.staticLayers.push_back( file.tellg() );
+				if ( !skipArray< Scene::CircleInstance >( file, fileSize ) || !skipArray< Scene::RectangleInstance >( file, fileSize ) )
+					return false;
+			}
+			// a frame without a static layer keeps the one before it, the first one has one
+			if ( sequence.staticLayers.empty() )
+				return false;
+
+			if ( !skipArray< Scene::CircleInstance >( file, fileSize ) || !skipArray< Scene::RectangleInstance >( file, fileSize ) )
+				return false;
+			sequence.times.push_back( time );
+			sequence.offsets.push_back( offset );
+			sequence.frameStaticLayers.push_back( uint32_t( sequence.staticLayers.size() - 1 ) );
+		}
+		return true;
+	}
+
+
+	Reader::Reader( Sequence const& sequence ) :
+		sequence( sequence ),
+		file( sequence.path, std::ios::binary )
+	{
+		fileSize = sizeOf( file );
+	}
+
+
+	Scene::Frame const& Reader::frameAt( double time )
+	{
+		const size_t index = sequence.frameAt( time );
+		if ( index != frameIndex )
+			readFrame( index );
+		return frame;
+	}
+
+
+	// the file was checked by load(), a frame that still can't be read keeps the previous one;
+	// frames carry their static layer's index as version, renderers cache it by that
+	void Reader::readFrame( size_t index )
+	{
+		frameIndex = index;
+		file.clear();
+
+		const uint32_t staticLayer = sequence.frameStaticLayers[ index ];
+		if ( frame.staticVersion != staticLayer + 1 )
+		{
+			file.seekg( sequence.staticLayers[ staticLayer ] );
+			if ( !readArray( file, fileSize, frame.staticCircles ) || !readArray( file, fileSize, frame.staticRectangles ) )
+				return;
+			frame.staticVersion = staticLayer + 1;
+		}
+
+		file.seekg( sequence.offsets[ index ] );
+		double time = 0.0;
+		uint8_t isStaticLayerChanged = 0;
+		if ( !readValue( file, frame.clearColor ) || !readValue( file, frame.camera ) || !readValue( file, frame.interpolation ) ||
+			!readValue( file, time ) || !readValue( file, isStaticLayerChanged ) )
+			return;
+		if ( isStaticLayerChanged &&
+			( !skipArray< Scene::CircleInstance >( file, fileSize ) || !skipArray< Scene::RectangleInstance >( file, fileSize ) ) )
+			return;
+		readArray( file, fileSize, frame.circles );
+		readArray( file, fileSize, frame.rectangles );
+	}
+}
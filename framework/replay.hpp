@@ -0,0 +1,114 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "frame.hpp"
+
+
+//-------------------------------------------------------
+//	replay: recorded sequence of frame snapshots, each
+//	stamped with the time it was published at
+//-------------------------------------------------------
+
+namespace Replay
+{
+	// write() only copies the frame, a thread of the writer's own puts it on disk,
+	// so recording keeps file i/o off the simulation thread; a writer that falls
+	// too far behind drops frames and says so on stderr
+	class Writer
+	{
+	public:
+		Writer() = default;
+		Writer( Writer const& ) = delete;
+		~Writer();
+
+		// frames are stamped by now(), Clock::now() when not given
+		bool open( char const* path, int framesPerSecond, double ( *now )() = nullptr );
+		// writes whatever is still queued
+		void close();
+		bool isOpen() const;
+
+		void write( Scene::Frame const& frame );
+
+	private:
+		struct Record
+		{
+			Scene::Frame frame;
+			bool isStaticLayerChanged = false;
+			double time = 0.0;
+		};
+
+		void writeLoop();
+		void writeRecord( Record const& record );
+
+		std::ofstream file;
+		double ( *now )() = nullptr;
+		double startTime = 0.0;
+		bool hasStaticLayer = false;
+		uint32_t staticVersion = 0;
+
+		std::thread worker;
+		std::mutex mutex;
+		std::condition_variable hasRecords;
+		std::deque< Record > queue;
+		// written records, their lists keep their capacity for the next copies
+		std::vector< Record > spare;
+		// since the writer thread last reported them
+		int droppedRecords = 0;
+		bool isClosing = false;
+	};
+
+
+	// where in the file every frame and static layer is, a few bytes per frame;
+	// the frames themselves stay on disk until a Reader asks for them
+	struct Sequence
+	{
+		std::string path;
+		int framesPerSecond = 0;
+		// one per frame: seconds since recording started, where the frame starts
+		// in the file, and which of the static layers it is drawn over
+		std::vector< double > times;
+		std::vector< std::streamoff > offsets;
+		std::vector< uint32_t > frameStaticLayers;
+		// where each static layer's lists start in the file
+		std::vector< std::streamoff > staticLayers;
+
+		double duration() const;
+		// index of the frame on screen at the given time, idle stretches hold the last frame
+		size_t frameAt( double time ) const;
+	};
+
+
+	// checks the whole file and indexes it, reading no more of a frame than its size
+	bool load( char const* path, Sequence& sequence );
+
+
+	// reads the frames of a loaded sequence on demand, so any length of recording takes
+	// the memory of one frame; the static layer is read only when it changes; a reader
+	// has a file of its own, so every thread reading the sequence takes its own reader
+	class Reader
+	{
+	public:
+		explicit Reader( Sequence const& sequence );
+
+		// the frame on screen at the given time, valid until the next call;
+		// the sequence must hold a frame
+		Scene::Frame const& frameAt( double time );
+
+	private:
+		void readFrame( size_t index );
+
+		Sequence const& sequence;
+		std::ifstream file;
+		std::streamoff fileSize = 0;
+		Scene::Frame frame;
+		size_t frameIndex = size_t( -1 );
+	};
+}
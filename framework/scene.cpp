@@ -1,26 +1,19 @@
-
-#define NOMINMAX
-#include <windows.h>
-#include <GL/gl.h>
-
 #include <cassert>
 #include <vector>
 #include <algorithm>
 #include <cmath>
 
+#include "frame.hpp"
+#include "gl_state.hpp"
+#include "replay.hpp"
 #include "scene.hpp"
+#include "triple_buffer.hpp"
 
 
 namespace Scene
 {
 	namespace
 	{
-		namespace View
-		{
-			constexpr float width = 16.f;
-			constexpr float height = 9.f;
-		}
-
 		constexpr float pi = 3.14159265f;
 
 
@@ -34,26 +27,58 @@ namespace Scene
 		};
 
 
-		void setupGLColor( Color color )
+		TripleBuffer< Frame > frames;
+		uint32_t frameTraceId = 0;
+		uint32_t stepTrace = 0;
+		// bumped whenever the background, a static mesh or the camera changes
+		uint32_t staticVersion = 1;
+		Camera camera;
+		Replay::Writer* frameRecorder = nullptr;
+
+
+		Rgb colorComponents( Color color )
 		{
 			switch ( color )
 			{
 				case Color::red:
-					glColor3f( 1.f, 0.f, 0.f );
-					break;
+					return { 1.f, 0.f, 0.f };
 				case Color::green:
-					glColor3f( 0.f, 1.f, 0.f );
-					break;
+					return { 0.f, 1.f, 0.f };
 				case Color::blue:
-					glColor3f( 0.f, 0.f, 1.f );
-					break;
+					return { 0.f, 0.f, 1.f };
 				case Color::black:
-					glColor3f( 0.f, 0.f, 0.f );
-					break;
+					return { 0.f, 0.f, 0.f };
 				case Color::white:
-					glColor3f( 1.f, 1.f, 1.f );
-					break;
+					return { 1.f, 1.f, 1.f };
 			}
+			return { 0.f, 0.f, 0.f };
+		}
+
+
+		void invalidateStaticLayer()
+		{
+			staticVersion++;
+		}
+
+
+		// world space bounds against the rectangle the camera shows
+		bool isInView( float left, float bottom, float right, float top )
+		{
+			return right >= camera.centerX - camera.halfWidth() && left <= camera.centerX + camera.halfWidth() &&
+				top >= camera.centerY - camera.halfHeight() && bottom <= camera.centerY + camera.halfHeight();
+		}
+
+
+		void drawRectangle( RectangleInstance const& rectangle )
+		{
+			Gl::loadIdentity();
+			Gl::color( rectangle.color.r, rectangle.color.g, rectangle.color.b );
+			Gl::begin( Gl::Primitive::triangleStrip );
+			Gl::vertex( rectangle.left, rectangle.top );
+			Gl::vertex( rectangle.right, rectangle.top );
+			Gl::vertex( rectangle.left, rectangle.bottom );
+			Gl::vertex( rectangle.right, rectangle.bottom );
+			Gl::end();
 		}
 	}
 }
@@ -68,18 +93,29 @@ namespace Scene
 	class Mesh
 	{
 	public:
+		// state of the previous and the current simulation step
+		float previousX = 0.f;
+		float previousY = 0.f;
+		float previousAngle = 0.f;
 		float positionX = 0.f;
 		float positionY = 0.f;
 		float angle = 0.f;
+		bool isPlaced = false;
+		// part of the cached static layer, never interpolated
+		bool isStatic = false;
+		bool isVisible = true;
 
 		virtual ~Mesh();
-		virtual void draw();
+		virtual void capture( Frame& frame ) const = 0;
 
+		// visible meshes in creation order, only these are stepped and captured
 		static std::vector< Mesh* > meshes;
+		static std::vector< Mesh* > hiddenMeshes;
 	};
 
 
 	std::vector< Mesh* > Mesh::meshes;
+	std::vector< Mesh* > Mesh::hiddenMeshes;
 
 
 	Mesh::~Mesh()
@@ -87,14 +123,6 @@ namespace Scene
 	}
 
 
-	void Mesh::draw()
-	{
-		glLoadIdentity();
-		glTranslatef( positionX, positionY, 0.f );
-		glRotatef( angle * 180.f / pi, 0.f, 0.f, 1.f );
-	}
-
-
 	template< class MeshClass, class... Args >
 	Mesh* createMesh( Args&&... args )
 	{
@@ -106,19 +134,62 @@ namespace Scene
 
 	void destroyMesh( Mesh* mesh )
 	{
-		auto it = std::find( Mesh::meshes.begin(), Mesh::meshes.end(), mesh );
-		assert( it != Mesh::meshes.end() );
-		Mesh::meshes.erase( it );
+		std::vector< Mesh* >& list = mesh->isVisible ? Mesh::meshes : Mesh::hiddenMeshes;
+		auto it = std::find( list.begin(), list.end(), mesh );
+		assert( it != list.end() );
+		list.erase( it );
+		if ( mesh->isStatic )
+			invalidateStaticLayer();
 		delete mesh;
 	}
 
 
 	void placeMesh( Mesh* mesh, float x, float y, float angle )
 	{
+		if ( !mesh->isPlaced )
+		{
+			teleportMesh( mesh, x, y, angle );
+			return;
+		}
+		if ( mesh->isStatic && ( mesh->positionX != x || mesh->positionY != y || mesh->angle != angle ) )
+			invalidateStaticLayer();
 		mesh->positionX = x;
 		mesh->positionY = y;
 		mesh->angle = angle;
 	}
+
+
+	void teleportMesh( Mesh* mesh, float x, float y, float angle )
+	{
+		mesh->previousX = mesh->positionX = x;
+		mesh->previousY = mesh->positionY = y;
+		mesh->previousAngle = mesh->angle = angle;
+		mesh->isPlaced = true;
+		if ( mesh->isStatic )
+			invalidateStaticLayer();
+	}
+
+
+	void setMeshVisible( Mesh* mesh, bool isVisible )
+	{
+		if ( mesh->isVisible == isVisible )
+			return;
+
+		std::vector< Mesh* >& from = isVisible ? Mesh::hiddenMeshes : Mesh::meshes;
+		std::vector< Mesh* >& to = isVisible ? Mesh::meshes : Mesh::hiddenMeshes;
+		auto it = std::find( from.begin(), from.end(), mesh );
+		assert( it != from.end() );
+		from.erase( it );
+		to.push_back( mesh );
+		mesh->isVisible = isVisible;
+
+		// hidden meshes are not stepped, so don't interpolate from wherever it was hidden
+		mesh->previousX = mesh->positionX;
+		mesh->previousY = mesh->positionY;
+		mesh->previousAngle = mesh->angle;
+		if ( mesh->isStatic )
+			invalidateStaticLayer();
+	}
 }
 
 
@@ -134,7 +205,7 @@ namespace Scene
 		{
 		public:
 			CircleMesh( float radius, Color color );
-			void draw() override;
+			void capture( Frame& frame ) const override;
 
 		private:
 			float const radius;
@@ -149,23 +220,98 @@ namespace Scene
 		}
 
 
-		void CircleMesh::draw()
+		void CircleMesh::capture( Frame& frame ) const
+		{
+			// anywhere between the last two steps, the renderer interpolates
+			if ( !isInView( std::min( previousX, positionX ) - radius, std::min( previousY, positionY ) - radius,
+				std::max( previousX, positionX ) + radius, std::max( previousY, positionY ) + radius ) )
+				return;
+
+			if ( isStatic )
+				frame.staticCircles.push_back( { positionX, positionY, angle, positionX, positionY, angle, radius, colorComponents( color ) } );
+			else
+				frame.circles.push_back( { previousX, previousY, previousAngle, positionX, positionY, angle, radius, colorComponents( color ) } );
+		}
+
+
+		//-------------------------------------------------------
+		//	circle level of detail: segment count chosen from the
+		//	radius in pixels, outlines come from precomputed tables
+		//-------------------------------------------------------
+
+		namespace Tessellation
 		{
-			Mesh::draw();
+			constexpr int levelCount = 10;
+			constexpr int segments[ levelCount ] = { 6, 8, 12, 16, 24, 32, 48, 64, 96, 128 };
+			// allowed gap between a segment and the true outline, in pixels
+			constexpr float tolerance = 0.25f;
 
-			constexpr int numTriangles = 16;
 
-			glBegin( GL_TRIANGLES );
-			setupGLColor( color );
-			for ( int i = 0; i < numTriangles; i++ )
+			struct Level
 			{
-				float angle1 = float( i ) / float( numTriangles ) * 2.f * pi;
-				float angle2 = float( i + 1 ) / float( numTriangles ) * 2.f * pi;
-				glVertex2f( radius * std::cos( angle1 ), radius * std::sin( angle1 ) );
-				glVertex2f( 0.f, 0.f );
-				glVertex2f( radius * std::cos( angle2 ), radius * std::sin( angle2 ) );
+				// closed outline of the unit circle, first point repeated at the end
+				std::vector< float > x;
+				std::vector< float > y;
+				// largest radius in pixels the level keeps within tolerance
+				float maxRadius;
+			};
+
+
+			std::vector< Level > const& levels()
+			{
+				static const std::vector< Level > table = []
+				{
+					std::vector< Level > result( levelCount );
+					for ( int level = 0; level < levelCount; level++ )
+					{
+						const int count = segments[ level ];
+						for ( int i = 0; i <= count; i++ )
+						{
+							const float angle = float( i % count ) / float( count ) * 2.f * pi;
+							result[ level ].x.push_back( std::cos( angle ) );
+							result[ level ].y.push_back( std::sin( angle ) );
+						}
+						// the segment midpoint lies r * ( 1 - cos( pi / n ) ) inside the circle
+						result[ level ].maxRadius = tolerance / ( 1.f - std::cos( pi / float( count ) ) );
+					}
+					return result;
+				}();
+				return table;
+			}
+
+
+			int selectLevel( float radiusPixels )
+			{
+				std::vector< Level > const& table = levels();
+				for ( int level = 0; level < levelCount; level++ )
+					if ( radiusPixels <= table[ level ].maxRadius )
+						return level;
+				return levelCount - 1;
+			}
+
+
+			// a fan: center plus the closed outline
+			int vertexCount( int level )
+			{
+				return segments[ level ] + 2;
 			}
-			glEnd();
+		}
+
+
+		void drawCircle( CircleInstance const& circle, float alpha, int level )
+		{
+			Gl::loadIdentity();
+			Gl::translate( circle.x( alpha ), circle.y( alpha ), 0.f );
+			Gl::rotateZ( circle.rotation( alpha ) * 180.f / pi );
+
+			Tessellation::Level const& outline = Tessellation::levels()[ level ];
+
+			Gl::color( circle.color.r, circle.color.g, circle.color.b );
+			Gl::begin( Gl::Primitive::triangleFan );
+			Gl::vertex( 0.f, 0.f );
+			for ( size_t i = 0; i < outline.x.size(); i++ )
+				Gl::vertex( circle.radius * outline.x[ i ], circle.radius * outline.y[ i ] );
+			Gl::end();
 		}
 	}
 
@@ -178,7 +324,10 @@ namespace Scene
 
 	Mesh *createPocketMesh( float radius )
 	{
-		return createMesh< CircleMesh >( radius, Color::red );
+		Mesh* mesh = createMesh< CircleMesh >( radius, Color::red );
+		mesh->isStatic = true;
+		invalidateStaticLayer();
+		return mesh;
 	}
 }
 
@@ -197,29 +346,19 @@ namespace Scene
 			float height = 0.f;
 
 
-			void draw()
+			void capture( Frame& frame )
 			{
-				auto drawRectangle = []( float left, float top, float right, float bottom ) -> void
-				{
-					glColor3f( 0.05f, 0.05f, 0.05f );
-					glBegin( GL_TRIANGLE_STRIP );
-					glVertex2f( left, top );
-					glVertex2f( right, top );
-					glVertex2f( left, bottom );
-					glVertex2f( right, bottom );
-					glEnd();
-				};
-
-				constexpr float viewHalfWidth = 0.5f * View::width;
-				constexpr float viewHalfHeight = 0.5f * View::height;
+				constexpr Rgb color = { 0.05f, 0.05f, 0.05f };
+				// at least the default view, more when the camera shows more
+				const float viewHalfWidth = std::max( 0.5f * View::width, std::abs( camera.centerX ) + camera.halfWidth() );
+				const float viewHalfHeight = std::max( 0.5f * View::height, std::abs( camera.centerY ) + camera.halfHeight() );
 				const float backHalfWidth = 0.5f * Background::width;
 				const float backHalfHeight = 0.5f * Background::height;
 
-				glLoadIdentity();
-				drawRectangle( -viewHalfWidth, viewHalfHeight, -backHalfWidth, -viewHalfHeight );
-				drawRectangle( backHalfWidth, viewHalfHeight, viewHalfWidth, -viewHalfHeight );
-				drawRectangle( -backHalfWidth, viewHalfHeight,backHalfWidth, backHalfHeight );
-				drawRectangle( -backHalfWidth, -backHalfHeight,backHalfWidth, -viewHalfHeight );
+				frame.staticRectangles.push_back( { -viewHalfWidth, viewHalfHeight, -backHalfWidth, -viewHalfHeight, color } );
+				frame.staticRectangles.push_back( { backHalfWidth, viewHalfHeight, viewHalfWidth, -viewHalfHeight, color } );
+				frame.staticRectangles.push_back( { -backHalfWidth, viewHalfHeight, backHalfWidth, backHalfHeight, color } );
+				frame.staticRectangles.push_back( { -backHalfWidth, -backHalfHeight, backHalfWidth, -viewHalfHeight, color } );
 			}
 		}
 	}
@@ -227,6 +366,8 @@ namespace Scene
 
 	void setupBackground( float width, float height )
 	{
+		if ( Background::width != width || Background::height != height )
+			invalidateStaticLayer();
 		Background::width = width;
 		Background::height = height;
 	}
@@ -251,16 +392,9 @@ namespace Scene
 			float bottom = -4.5f;
 
 
-			void draw()
+			void capture( Frame& frame )
 			{
-				glLoadIdentity();
-				glColor3f( 1.f, 0.f, 1.f );
-				glBegin( GL_TRIANGLE_STRIP );
-				glVertex2f( left, top );
-				glVertex2f( left + value * ( right - left ), top );
-				glVertex2f( left, bottom );
-				glVertex2f( left + value * ( right - left ), bottom );
-				glEnd();
+				frame.rectangles.push_back( { left, top, left + value * ( right - left ), bottom, { 1.f, 0.f, 1.f } } );
 			}
 		}
 	}
@@ -273,39 +407,254 @@ namespace Scene
 }
 
 
+//-------------------------------------------------------
+// user interface: camera support
+//-------------------------------------------------------
+
+namespace Scene
+{
+	void setCamera( float centerX, float centerY, float zoom )
+	{
+		assert( zoom > 0.f );
+		if ( camera.centerX == centerX && camera.centerY == centerY && camera.zoom == zoom )
+			return;
+
+		camera.centerX = centerX;
+		camera.centerY = centerY;
+		camera.zoom = zoom;
+		// what the static layer culls depends on the camera
+		invalidateStaticLayer();
+	}
+}
+
+
+//-------------------------------------------------------
+// user interface: latency tracing support
+//-------------------------------------------------------
+
+namespace Scene
+{
+	void traceFrame( uint32_t traceId )
+	{
+		// sticky, so the trace survives frames the renderer skips
+		frameTraceId = traceId;
+		stepTrace = traceId;
+	}
+}
+
+
 //-------------------------------------------------------
 //	engine only interface
 //-------------------------------------------------------
 
 namespace Scene
 {
-	void draw()
+	namespace
+	{
+		// display list of the static layer for one context
+		struct StaticList
+		{
+			uint32_t contextId = 0;
+			uint32_t version = 0;
+			float pixelsPerUnit = 0.f;
+			uint32_t list = 0;
+			int vertices = 0;
+		};
+
+		StaticList staticList;
+
+		int viewportWidth = 1280;
+		int viewportHeight = 720;
+		int vertexBudget = 0;
+		// per frame scratch: detail level of every dynamic circle
+		std::vector< int > circleLevels;
+
+
+		// circles stay round on either axis when the viewport aspect differs from the view's
+		float pixelsPerUnit( Camera const& view )
+		{
+			return std::max( float( viewportWidth ) / View::width, float( viewportHeight ) / View::height ) * view.zoom;
+		}
+
+
+		// coarsens every circle by the same number of levels until the frame fits the budget,
+		// or all of them are at the coarsest level
+		void fitVertexBudget( std::vector< int >& levels, int availableVertices )
+		{
+			for ( int coarsening = 0; coarsening < Tessellation::levelCount; coarsening++ )
+			{
+				int vertices = 0;
+				for ( int level : levels )
+					vertices += Tessellation::vertexCount( std::max( level - coarsening, 0 ) );
+				if ( vertices <= availableVertices || coarsening == Tessellation::levelCount - 1 )
+				{
+					for ( int& level : levels )
+						level = std::max( level - coarsening, 0 );
+					return;
+				}
+			}
+		}
+
+
+		void drawStaticLayer( Frame const& frame )
+		{
+			const float scale = pixelsPerUnit( frame.camera );
+			if ( staticList.contextId != Gl::contextId() || staticList.version != frame.staticVersion || staticList.pixelsPerUnit != scale )
+			{
+				// lists of a previous context went away with it
+				if ( staticList.list && staticList.contextId == Gl::contextId() )
+					Gl::deleteList( staticList.list );
+
+				staticList.list = Gl::createList();
+				staticList.vertices = 4 * int( frame.staticRectangles.size() );
+				Gl::beginList( staticList.list );
+				for ( CircleInstance const& circle : frame.staticCircles )
+				{
+					const int level = Tessellation::selectLevel( circle.radius * scale );
+					drawCircle( circle, 1.f, level );
+					staticList.vertices += Tessellation::vertexCount( level );
+				}
+				for ( RectangleInstance const& rectangle : frame.staticRectangles )
+					drawRectangle( rectangle );
+				Gl::endList();
+
+				staticList.contextId = Gl::contextId();
+				staticList.version = frame.staticVersion;
+				staticList.pixelsPerUnit = scale;
+			}
+			Gl::callList( staticList.list );
+		}
+	}
+
+
+	void beginStep()
+	{
+		for ( Mesh* mesh : Mesh::meshes )
+		{
+			mesh->previousX = mesh->positionX;
+			mesh->previousY = mesh->positionY;
+			mesh->previousAngle = mesh->angle;
+		}
+		stepTrace = 0;
+	}
+
+
+	uint32_t stepTraceId()
+	{
+		return stepTrace;
+	}
+
+
+	void publishFrame( float interpolation )
 	{
-		glMatrixMode( GL_PROJECTION );
-		glLoadIdentity();
-		glScalef( 2.f / View::width, 2.f / View::height, 0.f );
+		Frame& frame = frames.writeBuffer();
+
+		// each of the three buffers refreshes its static layer copy only once per change
+		if ( frame.staticVersion != staticVersion )
+		{
+			frame.staticCircles.clear();
+			for ( Mesh const* mesh : Mesh::meshes )
+				if ( mesh->isStatic )
+					mesh->capture( frame );
+
+			frame.staticRectangles.clear();
+			Background::capture( frame );
+			frame.staticVersion = staticVersion;
+		}
+
+		frame.circles.clear();
+		for ( Mesh const* mesh : Mesh::meshes )
+			if ( !mesh->isStatic )
+				mesh->capture( frame );
 
-		glDisable( GL_CULL_FACE );
-		glClearColor( 0.1f, 0.4f, 0.2f, 0.f );
-		glClear( GL_COLOR_BUFFER_BIT );
-		glMatrixMode( GL_MODELVIEW );
+		frame.rectangles.clear();
+		ProgressBar::capture( frame );
 
-		for ( Mesh *mesh : Mesh::meshes )
-			mesh->draw();
+		frame.camera = camera;
+		frame.interpolation = interpolation;
+		frame.traceId = frameTraceId;
 
-		Background::draw();
-		ProgressBar::draw();
+		if ( frameRecorder )
+			frameRecorder->write( frame );
+
+		frames.publish();
+	}
+
+
+	void recordFrames( Replay::Writer* writer )
+	{
+		frameRecorder = writer;
+	}
+
+
+	Frame const& acquireFrame()
+	{
+		frames.acquire();
+		return frames.readBuffer();
+	}
+
+
+	uint32_t draw()
+	{
+		return draw( acquireFrame() );
+	}
+
+
+	uint32_t draw( Frame const& frame )
+	{
+		Gl::beginFrame();
+
+		// issued only when the camera moved
+		Gl::matrixMode( Gl::MatrixMode::projection );
+		Gl::loadOrthographic( 1.f / frame.camera.halfWidth(), 1.f / frame.camera.halfHeight(), frame.camera.centerX, frame.camera.centerY );
+
+		Gl::setEnabled( Gl::Capability::cullFace, false );
+		Gl::clearColor( frame.clearColor.r, frame.clearColor.g, frame.clearColor.b, 0.f );
+		Gl::clear();
+		Gl::matrixMode( Gl::MatrixMode::modelview );
+
+		drawStaticLayer( frame );
+
+		const float scale = pixelsPerUnit( frame.camera );
+		circleLevels.resize( frame.circles.size() );
+		for ( size_t i = 0; i < frame.circles.size(); i++ )
+			circleLevels[ i ] = Tessellation::selectLevel( frame.circles[ i ].radius * scale );
+		// the static layer and rectangles are fixed costs, circles share the rest
+		if ( vertexBudget > 0 )
+			fitVertexBudget( circleLevels, vertexBudget - staticList.vertices - 4 * int( frame.rectangles.size() ) );
+
+		for ( size_t i = 0; i < frame.circles.size(); i++ )
+			drawCircle( frame.circles[ i ], frame.interpolation, circleLevels[ i ] );
+
+		for ( RectangleInstance const& rectangle : frame.rectangles )
+			drawRectangle( rectangle );
+
+		Gl::endFrame();
+		return frame.traceId;
+	}
+
+
+	void setViewport( int width, int height )
+	{
+		viewportWidth = width;
+		viewportHeight = height;
+	}
+
+
+	void setVertexBudget( int maxVertices )
+	{
+		vertexBudget = maxVertices;
 	}
 
 
 	float screenToWorldX( float x )
 	{
-		return 0.5f * View::width * ( 2.f * x - 1.f );
+		return camera.centerX + camera.halfWidth() * ( 2.f * x - 1.f );
 	}
 
 
 	float screenToWorldY( float y )
 	{
-		return 0.5f * View::height * ( 2.f * y - 1.f );
+		return camera.centerY + camera.halfHeight() * ( 2.f * y - 1.f );
 	}
 }
@@ -1,6 +1,8 @@
 
 #pragma once
 
+#include <cstdint>
+
 
 //-------------------------------------------------------
 //	user interface
@@ -14,10 +16,21 @@ namespace Scene
 	Mesh* createPocketMesh( float radius );
 	void destroyMesh( Mesh* mesh );
 	void placeMesh( Mesh* mesh, float x, float y, float angle );
+	// place without interpolating from the previous position
+	void teleportMesh( Mesh* mesh, float x, float y, float angle );
+	// hidden meshes are neither stepped nor drawn, meshes out of view are only not drawn
+	void setMeshVisible( Mesh* mesh, bool isVisible );
 
 	void setupBackground( float width, float height );
 
 	void updateProgressBar( float progress );
+
+	// world point at the center of the view and magnification, 1 shows View::width by View::height
+	void setCamera( float centerX, float centerY, float zoom );
+
+	// tag published frames with a latency trace until a newer one replaces it;
+	// the step it is tagged in is the one marked simulated
+	void traceFrame( uint32_t traceId );
 }
 
 
@@ -25,9 +38,44 @@ namespace Scene
 //	engine only interface
 //-------------------------------------------------------
 
+namespace Replay
+{
+	class Writer;
+}
+
 namespace Scene
 {
-	void draw();
+	struct Frame;
+
+	// simulation thread: remember current transforms before a fixed step
+	void beginStep();
+
+	// simulation thread: latency trace tagged since the last beginStep, 0 for none;
+	// the engine marks it simulated once the step is done, on its own clock
+	uint32_t stepTraceId();
+
+	// simulation thread: snapshot meshes for the renderer, which draws
+	// them interpolated between the last two steps by the given fraction
+	void publishFrame( float interpolation );
+
+	// every published frame is also written to the replay, nullptr stops recording
+	void recordFrames( Replay::Writer* writer );
+
+	// consumer side: latest published snapshot, for renderers other than draw()
+	Frame const& acquireFrame();
+
+	// render thread: draw the latest published snapshot,
+	// returns the latency trace id it carries
+	uint32_t draw();
+	// render thread: draw any frame, e.g. a grid of tables composed from several
+	uint32_t draw( Frame const& frame );
+
+	// render thread: pixel size of the drawable, circles are tessellated to stay round at it
+	void setViewport( int width, int height );
+
+	// render thread: coarsen circles so a frame submits at most this many vertices, 0 for no limit
+	void setVertexBudget( int maxVertices );
+	// through the camera of the simulation thread, screen coordinates in [0, 1] from the bottom left
 	float screenToWorldX( float x );
-	float screenToWorldY( float x );
+	float screenToWorldY( float y );
 }
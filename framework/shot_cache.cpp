@@ -0,0 +1,422 @@
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+#include "hash.hpp"
+#include "shot_cache.hpp"
+
+
+//-------------------------------------------------------
+//	key
+//-------------------------------------------------------
+
+namespace
+{
+	uint64_t quantize( float value, float step )
+	{
+		return uint64_t( int64_t( std::floor( value / step + 0.5f ) ) );
+	}
+
+	// the map's node and bucket, roughly, on top of the entry itself
+	const size_t slotBytes = 48;
+
+	size_t bytesOf( Game::ShotOutcome const& outcome )
+	{
+		return slotBytes + outcome.rest.capacity() * sizeof( Game::Ball ) + outcome.pocketed.capacity() * sizeof( int );
+	}
+}
+
+
+ShotCache::ShotCache( size_t memoryCap )
+	: ShotCache( memoryCap, Quantization() )
+{
+}
+
+
+ShotCache::ShotCache( size_t memoryCap, Quantization const& quantization )
+	: quantization( quantization )
+	, shardCap( memoryCap / shardCount )
+{
+}
+
+
+uint64_t ShotCache::key( Game::ShotSimulator const& simulator, Game::TableState const& state, Game::Shot const& shot ) const
+{
+	uint64_t hash = Hash::mix( simulator.layoutHash(), state.size() );
+	for ( Game::Ball const& ball : state )
+	{
+		// where a pocketed ball was doesn't matter
+		if ( ball.isPocketed )
+		{
+			hash = Hash::mix( hash, ~uint64_t( 0 ) );
+			continue;
+		}
+		hash = Hash::mix( hash, quantize( ball.x, quantization.position ) );
+		hash = Hash::mix( hash, quantize( ball.y, quantization.position ) );
+	}
+
+	float power = std::fmin( std::fmax( shot.power, 0.f ), 1.f );
+	hash = Hash::mix( hash, quantize( std::atan2( shot.directionY, shot.directionX ), quantization.angle ) );
+	hash = Hash::mix( hash, quantize( power, quantization.power ) );
+
+	Game::Physics const& physics = simulator.getPhysics();
+	hash = Hash::mix( hash, Hash::floatBits( physics.friction ) );
+	hash = Hash::mix( hash, Hash::floatBits( physics.impulse ) );
+	return Hash::mix( hash, Hash::floatBits( physics.accurance ) );
+}
+
+
+//-------------------------------------------------------
+//	shards
+//-------------------------------------------------------
+
+ShotCache::Shard& ShotCache::shardOf( uint64_t key )
+{
+	return shards[ key >> ( 64 - shardBits ) ];
+}
+
+
+bool ShotCache::find( uint64_t key, Game::ShotOutcome& outcome )
+{
+	Shard& shard = shardOf( key );
+	std::lock_guard< std::mutex > lock( shard.mutex );
+
+	auto slot = shard.slots.find( key );
+	if ( slot == shard.slots.end() )
+	{
+		shard.misses++;
+		return false;
+	}
+
+	Entry& entry = shard.entries[ slot->second ];
+	entry.isReferenced = true;
+	outcome = entry.outcome;
+	shard.hits++;
+	return true;
+}
+
+
+void ShotCache::insert( uint64_t key, Game::ShotOutcome const& outcome )
+{
+	Shard& shard = shardOf( key );
+	std::lock_guard< std::mutex > lock( shard.mutex );
+
+	// another thread simulated the same shot meanwhile
+	auto slot = shard.slots.find( key );
+	if ( slot != shard.slots.end() )
+	{
+		shard.entries[ slot->second ].isReferenced = true;
+		return;
+	}
+
+	Entry entry = { key, outcome, 0, false };
+	entry.bytes = sizeof( Entry ) + bytesOf( entry.outcome );
+	if ( entry.bytes > shardCap )
+		return;
+
+	while ( shard.bytes + entry.bytes > shardCap )
+		evictOne( shard );
+
+	shard.slots.emplace( key, uint32_t( shard.entries.size() ) );
+	shard.bytes += entry.bytes;
+	shard.entries.push_back( std::move( entry ) );
+}
+
+
+void ShotCache::evictOne( Shard& shard )
+{
+	// a second chance for everything hit since the hand last passed
+	while ( shard.entries[ shard.hand ].isReferenced )
+	{
+		shard.entries[ shard.hand ].isReferenced = false;
+		shard.hand = ( shard.hand + 1 ) % shard.entries.size();
+	}
+
+	Entry& victim = shard.entries[ shard.hand ];
+	shard.slots.erase( victim.key );
+	shard.bytes -= victim.bytes;
+	shard.evictions++;
+
+	// the last entry fills the hole, the hand looks at it next
+	if ( &victim != &shard.entries.back() )
+	{
+		victim = std::move( shard.entries.back() );
+		shard.slots[ victim.key ] = uint32_t( shard.hand );
+	}
+	shard.entries.pop_back();
+	if ( shard.hand >= shard.entries.size() )
+		shard.hand = 0;
+}
+
+
+Game::ShotOutcome ShotCache::simulate( Game::ShotSimulator& simulator, Game::TableState const& state, Game::Shot const& shot )
+{
+	uint64_t shotKey = key( simulator, state, shot );
+
+	Game::ShotOutcome outcome;
+	if ( find( shotKey, outcome ) )
+		return outcome;
+
+	outcome = simulator.simulate( state, shot );
+	insert( shotKey, outcome );
+	return outcome;
+}
+
+
+double ShotCache::Stats::hitRate() const
+{
+	uint64_t lookups = hits + misses;
+	return lookups ? double( hits ) / double( lookups ) : 0.0;
+}
+
+
+ShotCache::Stats ShotCache::stats() const
+{
+	Stats total;
+	for ( Shard const& shard : shards )
+	{
+		std::lock_guard< std::mutex > lock( shard.mutex );
+		total.hits += shard.hits;
+		total.misses += shard.misses;
+		total.evictions += shard.evictions;
+		total.entries += shard.entries.size();
+		total.bytes += shard.bytes;
+	}
+	return total;
+}
+
+
+void ShotCache::clear()
+{
+	for ( Shard& shard : shards )
+	{
+		std::lock_guard< std::mutex > lock( shard.mutex );
+		shard.slots.clear();
+		shard.entries.clear();
+		shard.hand = 0;
+		shard.bytes = 0;
+	}
+}
+
+
+//-------------------------------------------------------
+//	file: a header, then per entry its key, the resting table's
+//	hash, steps, scratch flag, ball and pocketed counts, the balls
+//	as x, y, pocketed and the pocketed ids; native byte order, 4
+//	byte fields but the key and the hash
+//-------------------------------------------------------
+
+namespace
+{
+	const char fileMagic[ 8 ] = { 'M', 'B', 'S', 'H', 'O', 'T', 'C', '1' };
+
+	struct FileHeader
+	{
+		char magic[ 8 ];
+		float position;
+		float angle;
+		float power;
+		uint32_t entries;
+	};
+
+	template< typename T >
+	void put( std::FILE* file, T value )
+	{
+		std::fwrite( &value, sizeof( value ), 1, file );
+	}
+
+	// a file mapped read only, load parses it in place and copies every entry into the shards
+	class MappedFile
+	{
+	public:
+		explicit MappedFile( char const* path )
+		{
+#ifdef _WIN32
+			file = CreateFileA( path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr );
+			if ( file == INVALID_HANDLE_VALUE )
+				return;
+			LARGE_INTEGER fileSize;
+			if ( !GetFileSizeEx( file, &fileSize ) || fileSize.QuadPart == 0 )
+				return;
+			mapping = CreateFileMappingA( file, nullptr, PAGE_READONLY, 0, 0, nullptr );
+			if ( !mapping )
+				return;
+			data = static_cast< unsigned char const* >( MapViewOfFile( mapping, FILE_MAP_READ, 0, 0, 0 ) );
+			if ( data )
+				size = size_t( fileSize.QuadPart );
+#else
+			descriptor = open( path, O_RDONLY );
+			if ( descriptor < 0 )
+				return;
+			struct stat status;
+			if ( fstat( descriptor, &status ) != 0 || status.st_size == 0 )
+				return;
+			void* view = mmap( nullptr, size_t( status.st_size ), PROT_READ, MAP_PRIVATE, descriptor, 0 );
+			if ( view == MAP_FAILED )
+				return;
+			data = static_cast< unsigned char const* >( view );
+			size = size_t( status.st_size );
+#endif
+		}
+
+		MappedFile( MappedFile const& ) = delete;
+
+		~MappedFile()
+		{
+#ifdef _WIN32
+			if ( data )
+				UnmapViewOfFile( data );
+			if ( mapping )
+				CloseHandle( mapping );
+			if ( file != INVALID_HANDLE_VALUE )
+				CloseHandle( file );
+#else
+			if ( data )
+				munmap( const_cast< unsigned char* >( data ), size );
+			if ( descriptor >= 0 )
+				close( descriptor );
+#endif
+		}
+
+		unsigned char const* data = nullptr;
+		size_t size = 0;
+
+	private:
+#ifdef _WIN32
+		HANDLE file = INVALID_HANDLE_VALUE;
+		HANDLE mapping = nullptr;
+#else
+		int descriptor = -1;
+#endif
+	};
+
+	// fields are copied out, records don't keep any alignment
+	class Reader
+	{
+	public:
+		Reader( unsigned char const* data, size_t size ) : at( data ), end( data + size ) {}
+
+		template< typename T >
+		bool get( T& value )
+		{
+			if ( size_t( end - at ) < sizeof( value ) )
+				return false;
+			std::memcpy( &value, at, sizeof( value ) );
+			at += sizeof( value );
+			return true;
+		}
+
+	private:
+		unsigned char const* at;
+		unsigned char const* end;
+	};
+}
+
+
+bool ShotCache::save( char const* path ) const
+{
+	std::FILE* file = std::fopen( path, "wb" );
+	if ( !file )
+		return false;
+
+	FileHeader header = {};
+	std::memcpy( header.magic, fileMagic, sizeof( fileMagic ) );
+	header.position = quantization.position;
+	header.angle = quantization.angle;
+	header.power = quantization.power;
+	// patched below, the shards are locked one at a time
+	put( file, header );
+
+	uint32_t count = 0;
+	for ( Shard const& shard : shards )
+	{
+		std::lock_guard< std::mutex > lock( shard.mutex );
+		for ( Entry const& entry : shard.entries )
+		{
+			put( file, entry.key );
+			put( file, entry.outcome.hash );
+			put( file, int32_t( entry.outcome.steps ) );
+			put( file, uint32_t( entry.outcome.isScratch ) );
+			put( file, uint32_t( entry.outcome.rest.size() ) );
+			put( file, uint32_t( entry.outcome.pocketed.size() ) );
+			for ( Game::Ball const& ball : entry.outcome.rest )
+			{
+				put( file, ball.x );
+				put( file, ball.y );
+				put( file, uint32_t( ball.isPocketed ) );
+			}
+			for ( int id : entry.outcome.pocketed )
+				put( file, int32_t( id ) );
+			count++;
+		}
+	}
+
+	header.entries = count;
+	std::fseek( file, 0, SEEK_SET );
+	put( file, header );
+
+	bool isWritten = !std::ferror( file );
+	return std::fclose( file ) == 0 && isWritten;
+}
+
+
+bool ShotCache::load( char const* path )
+{
+	MappedFile file( path );
+	if ( !file.data )
+		return false;
+
+	Reader reader( file.data, file.size );
+	FileHeader header;
+	if ( !reader.get( header ) || std::memcmp( header.magic, fileMagic, sizeof( fileMagic ) ) != 0 )
+		return false;
+	// a different grid would put the same shots under other keys
+	if ( header.position != quantization.position || header.angle != quantization.angle || header.power != quantization.power )
+		return false;
+
+	for ( uint32_t i = 0; i < header.entries; i++ )
+	{
+		uint64_t entryKey, hash;
+		int32_t steps;
+		uint32_t isScratch, ballCount, pocketedCount;
+		if ( !reader.get( entryKey ) || !reader.get( hash ) || !reader.get( steps ) || !reader.get( isScratch ) || !reader.get( ballCount ) || !reader.get( pocketedCount ) )
+			return false;
+		// no more than the file holds, whatever the counts say
+		if ( ( size_t( ballCount ) * 12 + size_t( pocketedCount ) * 4 ) > file.size )
+			return false;
+
+		Game::ShotOutcome outcome;
+		outcome.hash = hash;
+		outcome.steps = steps;
+		outcome.isScratch = isScratch != 0;
+		outcome.rest.resize( ballCount );
+		for ( Game::Ball& ball : outcome.rest )
+		{
+			uint32_t isPocketed;
+			if ( !reader.get( ball.x ) || !reader.get( ball.y ) || !reader.get( isPocketed ) )
+				return false;
+			ball.isPocketed = isPocketed != 0;
+		}
+		outcome.pocketed.resize( pocketedCount );
+		for ( int& id : outcome.pocketed )
+		{
+			int32_t value;
+			if ( !reader.get( value ) )
+				return false;
+			id = value;
+		}
+
+		insert( entryKey, outcome );
+	}
+	return true;
+}
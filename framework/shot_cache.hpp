@@ -0,0 +1,99 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "game.hpp"
+
+
+//-------------------------------------------------------
+//	shot outcomes remembered for every thread: keyed by a
+//	hash of the quantized table, shot and physics, so nearly
+//	the same shot from nearly the same table hits; split in
+//	independently locked shards, each evicting by CLOCK once
+//	it used its share of the memory cap
+//-------------------------------------------------------
+
+class ShotCache
+{
+public:
+	// what the key snaps to, finer than the aim preview or the AI can tell apart
+	struct Quantization
+	{
+		float position = 0.001f;	// table units
+		float angle = 0.0005f;		// radians of cue direction
+		float power = 0.001f;		// of the full charge
+	};
+
+	struct Stats
+	{
+		uint64_t hits = 0;
+		uint64_t misses = 0;
+		uint64_t evictions = 0;
+		size_t entries = 0;
+		size_t bytes = 0;
+
+		double hitRate() const;
+	};
+
+	// memoryCap counts the outcomes and the bookkeeping around them
+	explicit ShotCache( size_t memoryCap = size_t( 64 ) << 20 );
+	ShotCache( size_t memoryCap, Quantization const& quantization );
+	ShotCache( ShotCache const& ) = delete;
+
+	// the simulator's table and physics go into the key, shots on different tables or
+	// with different physics never share one
+	uint64_t key( Game::ShotSimulator const& simulator, Game::TableState const& state, Game::Shot const& shot ) const;
+
+	bool find( uint64_t key, Game::ShotOutcome& outcome );
+	void insert( uint64_t key, Game::ShotOutcome const& outcome );
+
+	// the remembered outcome, or the simulator's, which is then remembered
+	Game::ShotOutcome simulate( Game::ShotSimulator& simulator, Game::TableState const& state, Game::Shot const& shot );
+
+	Stats stats() const;
+	void clear();
+
+	// every entry to a file; load reads one written with the same quantization through
+	// a memory map and copies its entries in, so a new process starts warm
+	bool save( char const* path ) const;
+	bool load( char const* path );
+
+private:
+	static constexpr int shardBits = 4;
+	static constexpr int shardCount = 1 << shardBits;
+
+	struct Entry
+	{
+		uint64_t key;
+		Game::ShotOutcome outcome;
+		size_t bytes;
+		// hit since the clock hand last passed, new entries start without
+		// so outcomes looked up once go first
+		bool isReferenced;
+	};
+
+	// a cache line of its own, so locking one shard doesn't slow its neighbours
+	struct alignas( 64 ) Shard
+	{
+		mutable std::mutex mutex;
+		std::unordered_map< uint64_t, uint32_t > slots;
+		std::vector< Entry > entries;
+		size_t hand = 0;
+		size_t bytes = 0;
+		uint64_t hits = 0;
+		uint64_t misses = 0;
+		uint64_t evictions = 0;
+	};
+
+	Shard& shardOf( uint64_t key );
+	// frees the entry under the clock hand that wasn't hit since the hand last passed
+	void evictOne( Shard& shard );
+
+	Quantization quantization;
+	size_t shardCap;
+	Shard shards[ shardCount ];
+};
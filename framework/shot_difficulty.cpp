@@ -0,0 +1,173 @@
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+#include "shot_difficulty.hpp"
+
+
+ShotDifficulty::ShotDifficulty( ThreadPool& pool, Game::Variant variant )
+	: pool( pool )
+	, variant( variant )
+{
+}
+
+
+ShotDifficulty::~ShotDifficulty()
+{
+}
+
+
+// an estimate takes at least one sample, the interval of none is undefined
+void ShotDifficulty::setSettings( Settings const& newSettings )
+{
+	settings = newSettings;
+	settings.maxSamples = std::max( settings.maxSamples, 1 );
+}
+
+
+ShotDifficulty::Settings const& ShotDifficulty::getSettings() const
+{
+	return settings;
+}
+
+
+void ShotDifficulty::setPhysics( Game::Physics const& newPhysics )
+{
+	std::lock_guard< std::mutex > lock( mutex );
+	physics = newPhysics;
+	for ( auto& simulator : simulators )
+		simulator->setPhysics( physics );
+}
+
+
+ShotDifficulty::Estimate ShotDifficulty::estimate( Request const& request )
+{
+	return estimate( std::vector< Request >{ request } ).front();
+}
+
+
+std::vector< ShotDifficulty::Estimate > ShotDifficulty::estimate( std::vector< Request > const& requests )
+{
+	std::vector< Estimate > estimates( requests.size() );
+	std::vector< int > pending( requests.size() );
+	for ( size_t i = 0; i < requests.size(); i++ )
+		pending[ i ] = int( i );
+
+	const int batchSamples = std::max( settings.batchSamples, 1 );
+	const int roundBatches = std::max( settings.roundSamples / batchSamples, 1 );
+	std::vector< int > successes;
+	for ( int round = 0; !pending.empty(); round++ )
+	{
+		successes.assign( pending.size() * roundBatches, 0 );
+		pool.parallelFor( int( successes.size() ), [ & ]( int task )
+		{
+			const int index = pending[ task / roundBatches ];
+			const int batch = round * roundBatches + task % roundBatches;
+			const int samples = std::min( batchSamples, settings.maxSamples - batch * batchSamples );
+			if ( samples > 0 )
+				successes[ task ] = sampleBatch( requests[ index ], index, batch, samples );
+		} );
+
+		std::vector< int > unfinished;
+		for ( size_t i = 0; i < pending.size(); i++ )
+		{
+			Estimate& estimate = estimates[ pending[ i ] ];
+			for ( int batch = 0; batch < roundBatches; batch++ )
+				estimate.successes += successes[ i * roundBatches + batch ];
+			estimate.samples = std::min( ( round + 1 ) * roundBatches * batchSamples, settings.maxSamples );
+			updateInterval( estimate );
+
+			if ( estimate.samples < settings.maxSamples && estimate.high - estimate.low > 2.f * settings.halfWidth )
+				unfinished.push_back( pending[ i ] );
+		}
+		pending.swap( unfinished );
+	}
+	return estimates;
+}
+
+
+// seeded by the request and the batch, not the thread: the same requests give the same estimates
+int ShotDifficulty::sampleBatch( Request const& request, int requestIndex, int batch, int samples )
+{
+	std::seed_seq seed = { settings.seed, unsigned( requestIndex ), unsigned( batch ) };
+	std::mt19937 random( seed );
+	std::normal_distribution< float > normal( 0.f, 1.f );
+	std::uniform_real_distribution< float > uniform( -1.f, 1.f );
+	auto deviation = [ & ]
+	{
+		return settings.noise.distribution == Noise::Distribution::normal ? normal( random ) : uniform( random );
+	};
+
+	Game::ShotSimulator* simulator = acquireSimulator();
+	const float angle = std::atan2( request.shot.directionY, request.shot.directionX );
+	int successes = 0;
+	for ( int i = 0; i < samples; i++ )
+	{
+		const float cueAngle = angle + settings.noise.angle * deviation();
+		Game::Shot shot;
+		shot.directionX = std::cos( cueAngle );
+		shot.directionY = std::sin( cueAngle );
+		shot.power = request.shot.power + settings.noise.power * deviation();
+		if ( isSuccess( request, simulator->simulate( request.table, shot ) ) )
+			successes++;
+	}
+	releaseSimulator( simulator );
+	return successes;
+}
+
+
+bool ShotDifficulty::isSuccess( Request const& request, Game::ShotOutcome const& outcome ) const
+{
+	if ( outcome.isScratch )
+		return false;
+
+	for ( int id : outcome.pocketed )
+		if ( request.target < 0 ? id != 0 : id == request.target )
+			return true;
+	return false;
+}
+
+
+// unlike the normal approximation it stays inside [0, 1] and isn't empty at 0 or all successes
+void ShotDifficulty::updateInterval( Estimate& estimate ) const
+{
+	const double n = double( estimate.samples );
+	const double p = double( estimate.successes ) / n;
+	const double z2 = double( settings.z ) * double( settings.z );
+	const double center = ( p + z2 / ( 2.0 * n ) ) / ( 1.0 + z2 / n );
+	const double spread = settings.z * std::sqrt( p * ( 1.0 - p ) / n + z2 / ( 4.0 * n * n ) ) / ( 1.0 + z2 / n );
+
+	estimate.probability = float( p );
+	estimate.low = float( std::max( center - spread, 0.0 ) );
+	estimate.high = float( std::min( center + spread, 1.0 ) );
+}
+
+
+// one per thread sampling at a time, kept for the next estimate
+Game::ShotSimulator* ShotDifficulty::acquireSimulator()
+{
+	{
+		std::lock_guard< std::mutex > lock( mutex );
+		if ( !idleSimulators.empty() )
+		{
+			Game::ShotSimulator* simulator = idleSimulators.back();
+			idleSimulators.pop_back();
+			return simulator;
+		}
+	}
+
+	// made outside the lock, a big table takes a while to rack
+	std::unique_ptr< Game::ShotSimulator > simulator( new Game::ShotSimulator( variant ) );
+
+	std::lock_guard< std::mutex > lock( mutex );
+	simulator->setPhysics( physics );
+	simulators.push_back( std::move( simulator ) );
+	return simulators.back().get();
+}
+
+
+void ShotDifficulty::releaseSimulator( Game::ShotSimulator* simulator )
+{
+	std::lock_guard< std::mutex > lock( mutex );
+	idleSimulators.push_back( simulator );
+}
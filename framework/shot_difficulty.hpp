@@ -0,0 +1,100 @@
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "game.hpp"
+#include "thread_pool.hpp"
+
+
+//-------------------------------------------------------
+//	shot difficulty: the intended shot played again and
+//	again with the cue's angle and power perturbed, the
+//	share that succeeds estimates how likely a player is
+//	to make it; sampled in rounds until the confidence
+//	interval is tight enough, many shots at once
+//-------------------------------------------------------
+
+class ShotDifficulty
+{
+public:
+	// how far off a player's cue goes
+	struct Noise
+	{
+		enum class Distribution
+		{
+			normal,		// the deviations below are standard deviations
+			uniform		// the deviations below are half widths
+		};
+
+		Distribution distribution = Distribution::normal;
+		float angle = 0.01f;	// radians
+		float power = 0.03f;	// of the full charge
+	};
+
+	struct Settings
+	{
+		Noise noise;
+		// an estimate stops once its interval is at most twice this wide, or at maxSamples,
+		// which setSettings raises to 1
+		float halfWidth = 0.05f;
+		int maxSamples = 2000;
+		// standard score of the interval, 1.96 for 95%
+		float z = 1.96f;
+		// every round adds this many samples to each unfinished estimate, in batches of
+		// batchSamples on the pool; fixed, so estimates don't depend on the thread count
+		int roundSamples = 128;
+		int batchSamples = 16;
+		unsigned seed = 50;
+	};
+
+	struct Request
+	{
+		Game::TableState table;
+		Game::Shot shot;
+		// the ball the shot is for, -1 for any; a scratch always fails
+		int target = -1;
+	};
+
+	struct Estimate
+	{
+		float probability = 0.f;
+		// Wilson score interval
+		float low = 0.f;
+		float high = 1.f;
+		int samples = 0;
+		int successes = 0;
+	};
+
+	// the pool runs the samples, simulators of the variant are made as threads need them
+	explicit ShotDifficulty( ThreadPool& pool, Game::Variant variant = Game::Variant::standard );
+	ShotDifficulty( ShotDifficulty const& ) = delete;
+	~ShotDifficulty();
+
+	void setSettings( Settings const& settings );
+	Settings const& getSettings() const;
+	void setPhysics( Game::Physics const& physics );
+
+	Estimate estimate( Request const& request );
+	// a difficulty map: every request sampled alongside the others, finished ones drop out
+	std::vector< Estimate > estimate( std::vector< Request > const& requests );
+
+private:
+	// successes in one batch of perturbed shots
+	int sampleBatch( Request const& request, int requestIndex, int batch, int samples );
+	bool isSuccess( Request const& request, Game::ShotOutcome const& outcome ) const;
+	void updateInterval( Estimate& estimate ) const;
+
+	Game::ShotSimulator* acquireSimulator();
+	void releaseSimulator( Game::ShotSimulator* simulator );
+
+	ThreadPool& pool;
+	Game::Variant variant;
+	Settings settings;
+	Game::Physics physics;
+
+	std::mutex mutex;
+	std::vector< std::unique_ptr< Game::ShotSimulator > > simulators;
+	std::vector< Game::ShotSimulator* > idleSimulators;
+};
@@ -0,0 +1,140 @@
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <cstring>
+#include <new>
+#include <type_traits>
+
+
+//-------------------------------------------------------
+//	contiguous array of plain data with a runtime size:
+//	up to InlineCapacity elements live inside the object,
+//	more move to one cache line aligned heap block
+//-------------------------------------------------------
+
+template< class T, size_t InlineCapacity >
+class SmallVector
+{
+	static_assert( std::is_trivially_copyable< T >::value, "small vector elements are copied as plain bytes" );
+	static_assert( InlineCapacity > 0, "small vector needs inline room" );
+
+public:
+	static constexpr size_t heapAlignment = 64;
+
+	SmallVector() = default;
+	explicit SmallVector( size_t size );
+	SmallVector( SmallVector const& other );
+	~SmallVector();
+
+	SmallVector& operator = ( SmallVector const& other );
+
+	T* begin() { return items; }
+	T* end() { return items + count; }
+	T const* begin() const { return items; }
+	T const* end() const { return items + count; }
+	T* data() { return items; }
+	T const* data() const { return items; }
+
+	T& operator [] ( size_t i ) { assert( i < count ); return items[ i ]; }
+	T const& operator [] ( size_t i ) const { assert( i < count ); return items[ i ]; }
+
+	T& back() { assert( count > 0 ); return items[ count - 1 ]; }
+	T const& back() const { assert( count > 0 ); return items[ count - 1 ]; }
+
+	size_t size() const { return count; }
+	size_t capacity() const { return allocated; }
+	bool empty() const { return count == 0; }
+	// still in the object's own storage
+	bool isInline() const { return items == inlineItems(); }
+
+	void clear() { count = 0; }
+	void reserve( size_t newCapacity );
+	// new elements are value initialized
+	void resize( size_t newSize );
+	void push_back( T const& item );
+	void pop_back() { assert( count > 0 ); count--; }
+
+private:
+	T* inlineItems() { return reinterpret_cast< T* >( storage ); }
+	T const* inlineItems() const { return reinterpret_cast< T const* >( storage ); }
+
+	alignas( T ) unsigned char storage[ InlineCapacity * sizeof( T ) ];
+	T* items = inlineItems();
+	size_t count = 0;
+	size_t allocated = InlineCapacity;
+};
+
+
+template< class T, size_t InlineCapacity >
+SmallVector< T, InlineCapacity >::SmallVector( size_t size )
+{
+	resize( size );
+}
+
+
+template< class T, size_t InlineCapacity >
+SmallVector< T, InlineCapacity >::SmallVector( SmallVector const& other )
+{
+	*this = other;
+}
+
+
+template< class T, size_t InlineCapacity >
+SmallVector< T, InlineCapacity >::~SmallVector()
+{
+	if ( !isInline() )
+		::operator delete( items, std::align_val_t( heapAlignment ) );
+}
+
+
+template< class T, size_t InlineCapacity >
+SmallVector< T, InlineCapacity >& SmallVector< T, InlineCapacity >::operator = ( SmallVector const& other )
+{
+	if ( this == &other )
+		return *this;
+
+	count = 0;
+	reserve( other.count );
+	if ( other.count > 0 )
+		std::memcpy( static_cast< void* >( items ), other.items, other.count * sizeof( T ) );
+	count = other.count;
+	return *this;
+}
+
+
+template< class T, size_t InlineCapacity >
+void SmallVector< T, InlineCapacity >::reserve( size_t newCapacity )
+{
+	if ( newCapacity <= allocated )
+		return;
+
+	T* newItems = static_cast< T* >( ::operator new( newCapacity * sizeof( T ), std::align_val_t( heapAlignment ) ) );
+	if ( count > 0 )
+		std::memcpy( static_cast< void* >( newItems ), items, count * sizeof( T ) );
+	if ( !isInline() )
+		::operator delete( items, std::align_val_t( heapAlignment ) );
+	items = newItems;
+	allocated = newCapacity;
+}
+
+
+template< class T, size_t InlineCapacity >
+void SmallVector< T, InlineCapacity >::resize( size_t newSize )
+{
+	reserve( newSize );
+	for ( size_t i = count; i < newSize; i++ )
+		new ( items + i ) T();
+	count = newSize;
+}
+
+
+template< class T, size_t InlineCapacity >
+void SmallVector< T, InlineCapacity >::push_back( T const& item )
+{
+	// item may live in the storage that grows
+	const T copy = item;
+	if ( count == allocated )
+		reserve( allocated * 2 );
+	items[ count++ ] = copy;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+
+
+//-------------------------------------------------------
+//	lock-free single producer / single consumer ring buffer
+//-------------------------------------------------------
+
+template< class T, size_t Capacity >
+class SpscRing
+{
+	static_assert( Capacity > 0 && ( Capacity & ( Capacity - 1 ) ) == 0, "ring capacity must be a power of two" );
+
+public:
+	SpscRing() = default;
+	SpscRing( SpscRing const& ) = delete;
+
+	// producer side, returns false if the ring is full
+	bool push( T const& item );
+
+	// consumer side, returns false if the ring is empty
+	bool pop( T& item );
+
+	bool isEmpty() const;
+
+private:
+	T items[ Capacity ];
+
+	alignas( 64 ) std::atomic< size_t > head = { 0 };
+	alignas( 64 ) std::atomic< size_t > tail = { 0 };
+};
+
+
+template< class T, size_t Capacity >
+bool SpscRing< T, Capacity >::push( T const& item )
+{
+	const size_t currentTail = tail.load( std::memory_order_relaxed );
+	if ( currentTail - head.load( std::memory_order_acquire ) == Capacity )
+		return false;
+
+	items[ currentTail & ( Capacity - 1 ) ] = item;
+	tail.store( currentTail + 1, std::memory_order_release );
+	return true;
+}
+
+
+template< class T, size_t Capacity >
+bool SpscRing< T, Capacity >::pop( T& item )
+{
+	const size_t currentHead = head.load( std::memory_order_relaxed );
+	if ( currentHead == tail.load( std::memory_order_acquire ) )
+		return false;
+
+	item = items[ currentHead & ( Capacity - 1 ) ];
+	head.store( currentHead + 1, std::memory_order_release );
+	return true;
+}
+
+
+template< class T, size_t Capacity >
+bool SpscRing< T, Capacity >::isEmpty() const
+{
+	return head.load( std::memory_order_acquire ) == tail.load( std::memory_order_acquire );
+}
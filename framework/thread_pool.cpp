@@ -0,0 +1,92 @@
+#include <algorithm>
+
+#include "thread_pool.hpp"
+
+
+ThreadPool::ThreadPool( int threadCount )
+{
+	if ( threadCount <= 0 )
+		threadCount = int( std::max( 1u, std::thread::hardware_concurrency() ) );
+
+	for ( int i = 1; i < threadCount; i++ )
+		workers.emplace_back( &ThreadPool::workerLoop, this );
+}
+
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard< std::mutex > lock( mutex );
+		isStopping = true;
+	}
+	wakeWorkers.notify_all();
+	for ( std::thread& worker : workers )
+		worker.join();
+}
+
+
+int ThreadPool::size() const
+{
+	return int( workers.size() ) + 1;
+}
+
+
+void ThreadPool::parallelFor( int count, std::function< void( int ) > const& newTask )
+{
+	if ( count <= 0 )
+		return;
+
+	if ( workers.empty() || count == 1 )
+	{
+		for ( int i = 0; i < count; i++ )
+			newTask( i );
+		return;
+	}
+
+	{
+		std::lock_guard< std::mutex > lock( mutex );
+		task = &newTask;
+		taskCount = count;
+		nextTask.store( 0, std::memory_order_relaxed );
+		busyWorkers = int( workers.size() );
+		jobGeneration++;
+	}
+	wakeWorkers.notify_all();
+
+	runTasks();
+
+	std::unique_lock< std::mutex > lock( mutex );
+	jobFinished.wait( lock, [ this ] { return busyWorkers == 0; } );
+	task = nullptr;
+}
+
+
+void ThreadPool::workerLoop()
+{
+	unsigned seenGeneration = 0;
+	while ( true )
+	{
+		{
+			std::unique_lock< std::mutex > lock( mutex );
+			wakeWorkers.wait( lock, [ & ] { return isStopping || jobGeneration != seenGeneration; } );
+			if ( isStopping )
+				return;
+			seenGeneration = jobGeneration;
+		}
+
+		runTasks();
+
+		{
+			std::lock_guard< std::mutex > lock( mutex );
+			busyWorkers--;
+		}
+		jobFinished.notify_one();
+	}
+}
+
+
+void ThreadPool::runTasks()
+{
+	for ( int i = nextTask.fetch_add( 1, std::memory_order_relaxed ); i < taskCount; i = nextTask.fetch_add( 1, std::memory_order_relaxed ) )
+		( *task )( i );
+}
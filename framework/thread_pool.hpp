@@ -0,0 +1,45 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+//-------------------------------------------------------
+//	fixed set of worker threads running index ranges in parallel
+//-------------------------------------------------------
+
+class ThreadPool
+{
+public:
+	// threadCount includes the calling thread, 0 means one per hardware thread
+	explicit ThreadPool( int threadCount = 0 );
+	ThreadPool( ThreadPool const& ) = delete;
+	~ThreadPool();
+
+	int size() const;
+
+	// calls task( i ) for every i in [0, count), returns when all are done;
+	// the calling thread takes part in the work
+	void parallelFor( int count, std::function< void( int ) > const& task );
+
+private:
+	void workerLoop();
+	void runTasks();
+
+	std::vector< std::thread > workers;
+
+	std::mutex mutex;
+	std::condition_variable wakeWorkers;
+	std::condition_variable jobFinished;
+	bool isStopping = false;
+	unsigned jobGeneration = 0;
+	int busyWorkers = 0;
+
+	std::function< void( int ) > const* task = nullptr;
+	int taskCount = 0;
+	std::atomic< int > nextTask = { 0 };
+};
@@ -0,0 +1,147 @@
+#include <algorithm>
+#include <cstring>
+
+#include "transposition_table.hpp"
+
+
+//-------------------------------------------------------
+//	slot data: the value's bits, then depth, bound + 1,
+//	generation and move + 1 above them; empty slots are 0
+//-------------------------------------------------------
+
+namespace
+{
+	const int depthShift = 32;
+	const int boundShift = 40;
+	const int generationShift = 42;
+	const int moveShift = 48;
+	const unsigned generationMask = 0x3f;
+
+	int depthOf( uint64_t data )
+	{
+		return int( ( data >> depthShift ) & 0xff );
+	}
+
+	unsigned generationOf( uint64_t data )
+	{
+		return unsigned( data >> generationShift ) & generationMask;
+	}
+}
+
+
+TranspositionTable::TranspositionTable( size_t bytes )
+{
+	size_t count = 1;
+	while ( count * 2 * sizeof( Bucket ) <= bytes )
+		count *= 2;
+
+	buckets.reset( new Bucket[ count ] );
+	bucketMask = count - 1;
+	clear();
+}
+
+
+uint64_t TranspositionTable::pack( Entry const& entry ) const
+{
+	uint32_t valueBits;
+	std::memcpy( &valueBits, &entry.value, sizeof( valueBits ) );
+
+	return uint64_t( valueBits )
+		| uint64_t( std::min( std::max( entry.depth, 0 ), 255 ) ) << depthShift
+		| uint64_t( int( entry.bound ) + 1 ) << boundShift
+		| uint64_t( generation ) << generationShift
+		| uint64_t( uint16_t( entry.move + 1 ) ) << moveShift;
+}
+
+
+TranspositionTable::Entry TranspositionTable::unpack( uint64_t data )
+{
+	Entry entry;
+	const uint32_t valueBits = uint32_t( data );
+	std::memcpy( &entry.value, &valueBits, sizeof( valueBits ) );
+	entry.depth = depthOf( data );
+	entry.bound = Bound( int( ( data >> boundShift ) & 0x3 ) - 1 );
+	entry.move = int( data >> moveShift ) - 1;
+	return entry;
+}
+
+
+bool TranspositionTable::probe( uint64_t key, Entry& entry ) const
+{
+	Bucket const& bucket = buckets[ key & bucketMask ];
+	for ( int i = 0; i < slotCount; i++ )
+	{
+		const uint64_t data = bucket.data[ i ].load( std::memory_order_relaxed );
+		const uint64_t check = bucket.checks[ i ].load( std::memory_order_relaxed );
+		if ( data && ( check ^ data ) == key )
+		{
+			entry = unpack( data );
+			return true;
+		}
+	}
+	return false;
+}
+
+
+void TranspositionTable::store( uint64_t key, Entry const& entry )
+{
+	Bucket& bucket = buckets[ key & bucketMask ];
+
+	int victim = 0;
+	int victimScore = 1 << 30;
+	for ( int i = 0; i < slotCount; i++ )
+	{
+		const uint64_t data = bucket.data[ i ].load( std::memory_order_relaxed );
+		const uint64_t check = bucket.checks[ i ].load( std::memory_order_relaxed );
+		if ( !data )
+		{
+			victim = i;
+			break;
+		}
+		if ( ( check ^ data ) == key )
+		{
+			if ( generationOf( data ) == generation && depthOf( data ) > entry.depth && entry.bound != Bound::exact )
+				return;
+			victim = i;
+			break;
+		}
+
+		// a search ago counts as much as eight turns of depth
+		const int age = int( ( generation - generationOf( data ) ) & generationMask );
+		const int score = depthOf( data ) - 8 * age;
+		if ( score < victimScore )
+		{
+			victim = i;
+			victimScore = score;
+		}
+	}
+
+	// two stores racing for the slot may mix their halves, the check then fails for both keys
+	const uint64_t data = pack( entry );
+	bucket.data[ victim ].store( data, std::memory_order_relaxed );
+	bucket.checks[ victim ].store( key ^ data, std::memory_order_relaxed );
+}
+
+
+void TranspositionTable::newSearch()
+{
+	generation = ( generation + 1 ) & generationMask;
+}
+
+
+void TranspositionTable::clear()
+{
+	for ( size_t i = 0; i <= bucketMask; i++ )
+		for ( int slot = 0; slot < slotCount; slot++ )
+		{
+			buckets[ i ].data[ slot ].store( 0, std::memory_order_relaxed );
+			buckets[ i ].checks[ slot ].store( 0, std::memory_order_relaxed );
+		}
+	generation = 0;
+}
+
+
+size_t TranspositionTable::capacity() const
+{
+	return ( bucketMask + 1 ) * slotCount;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+
+//-------------------------------------------------------
+//	transposition table shared by parallel search workers
+//	without locks: a slot holds its data and the key xor-ed
+//	with it, a slot torn by two writers fails the key check
+//	and reads as a miss
+//-------------------------------------------------------
+
+class TranspositionTable
+{
+public:
+	// how the value relates to the position's true one, a cutoff leaves only a bound
+	enum class Bound : uint8_t
+	{
+		exact,
+		lower,
+		upper
+	};
+
+	struct Entry
+	{
+		float value = 0.f;
+		// turns searched below the position, up to 255
+		int depth = 0;
+		Bound bound = Bound::exact;
+		// the best shot's index in the searcher's own list, -1 for none, up to 65534
+		int move = -1;
+	};
+
+	// rounded down to a power of two of buckets, four slots in a cache line each
+	explicit TranspositionTable( size_t bytes );
+	TranspositionTable( TranspositionTable const& ) = delete;
+
+	bool probe( uint64_t key, Entry& entry ) const;
+	// a shallower entry of the same search doesn't replace a deeper one of the same
+	// position, others go to the bucket's slot with the least depth for their age
+	void store( uint64_t key, Entry const& entry );
+
+	// between searches, neither while one runs: entries of earlier searches give way first
+	void newSearch();
+	void clear();
+	size_t capacity() const;
+
+private:
+	static constexpr int slotCount = 4;
+
+	struct alignas( 64 ) Bucket
+	{
+		std::atomic< uint64_t > checks[ slotCount ];
+		std::atomic< uint64_t > data[ slotCount ];
+	};
+
+	uint64_t pack( Entry const& entry ) const;
+	static Entry unpack( uint64_t data );
+
+	std::unique_ptr< Bucket[] > buckets;
+	size_t bucketMask = 0;
+	unsigned generation = 0;
+};
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+
+//-------------------------------------------------------
+//	lock-free single producer / single consumer triple buffer
+//
+//	producer fills writeBuffer() and calls publish(),
+//	consumer calls acquire() and reads readBuffer();
+//	neither side ever waits for the other
+//-------------------------------------------------------
+
+template< class T >
+class TripleBuffer
+{
+public:
+	TripleBuffer() = default;
+	TripleBuffer( TripleBuffer const& ) = delete;
+
+	T& writeBuffer();
+	void publish();
+
+	bool acquire();
+	T const& readBuffer() const;
+
+private:
+	static constexpr uint8_t indexMask = 0x3;
+	static constexpr uint8_t freshBit = 0x4;
+
+	T buffers[ 3 ];
+
+	alignas( 64 ) uint8_t backIndex = 0;
+	alignas( 64 ) std::atomic< uint8_t > middleIndex = { 1 };
+	alignas( 64 ) uint8_t frontIndex = 2;
+};
+
+
+template< class T >
+T& TripleBuffer< T >::writeBuffer()
+{
+	return buffers[ backIndex ];
+}
+
+
+template< class T >
+void TripleBuffer< T >::publish()
+{
+	uint8_t previous = middleIndex.exchange( uint8_t( backIndex | freshBit ), std::memory_order_acq_rel );
+	backIndex = previous & indexMask;
+}
+
+
+// returns false if nothing new was published since the last call
+template< class T >
+bool TripleBuffer< T >::acquire()
+{
+	if ( !( middleIndex.load( std::memory_order_relaxed ) & freshBit ) )
+		return false;
+
+	uint8_t previous = middleIndex.exchange( frontIndex, std::memory_order_acq_rel );
+	frontIndex = previous & indexMask;
+	return true;
+}
+
+
+template< class T >
+T const& TripleBuffer< T >::readBuffer() const
+{
+	return buffers[ frontIndex ];
+}
@@ -1,13 +1,21 @@
 
 #include <cassert>
 #include <cmath>
+#include <algorithm>
 #include <array>
-#include <unordered_set>
+#include <cstdint>
+#include <cstring>
+#include <utility>
 #include <iostream>
+#include <memory>
+#include <vector>
 
 #include "../framework/scene.hpp"
 #include "../framework/game.hpp"
 #include "../framework/engine.hpp"
+#include "../framework/hash.hpp"
+#include "../framework/latency.hpp"
+#include "../framework/small_vector.hpp"
 
 
 //-------------------------------------------------------
@@ -110,47 +118,309 @@ namespace Params
 	namespace System
 	{
 		constexpr int targetFPS = 60;
-		constexpr float accurance = 0.01f;
+		// physics runs at a lower fixed rate, rendering interpolates between steps
+		constexpr int simulationRate = 30;
+
+		// every ball steps on its own: at most this fraction of its radius per step,
+		// so fast balls don't tunnel, and at most one simulation step, so none stands still
+		constexpr float localStepRadii = 0.5f;
+
+		// tables with at least this many balls find contacts through a grid,
+		// smaller ones simply test every pair
+		constexpr int gridBallCount = 64;
+		// from this many balls on the grid's storage is kept in Morton order; below it
+		// the balls fit the L2 cache and the sort costs more than its locality saves
+		constexpr int sortBallCount = 32768;
 	}
 
-	namespace Table
+	namespace Shot
 	{
-		constexpr float width = 15.f;
-		constexpr float height = 8.f;
-		constexpr float pocketRadius = 0.4f;
+		constexpr float chargeTime = 1.f;
+		// an off screen shot gives up after an hour of simulated time
+		constexpr int maxSteps = 3600 * System::simulationRate;
+	}
 
-		static constexpr std::array< Vector2, 6 > pocketsPositions =
-		{
-			Vector2{ -0.5f * width, -0.5f * height },
-			Vector2{ 0.f, -0.5f * height },
-			Vector2{ 0.5f * width, -0.5f * height },
-			Vector2{ -0.5f * width, 0.5f * height },
-			Vector2{ 0.f, 0.5f * height },
-			Vector2{ 0.5f * width, 0.5f * height }
-		};
-
-		static constexpr std::array< Vector2, 7 > ballsPositions =
+
+	// table variants: everything the physics asks about a table is a compile time constant
+
+	// the game as it always was
+	struct Standard
+	{
+		static constexpr float width = 15.f;
+		static constexpr float height = 8.f;
+		static constexpr float pocketRadius = 0.4f;
+		static constexpr float ballRadius = 0.3f;
+		static constexpr int ballCount = 7;
+		static constexpr int pocketCount = 6;
+		// pitch of the rack's columns and of the balls within a column
+		static constexpr float columnSpacing = 0.05f * width;
+		static constexpr float rowSpacing = 0.1f * height;
+	};
+
+	struct Pool : Standard
+	{
+		static constexpr int ballCount = 16;
+	};
+
+	struct Snooker : Standard
+	{
+		static constexpr float pocketRadius = 0.35f;
+		static constexpr float ballRadius = 0.25f;
+		static constexpr int ballCount = 22;
+		static constexpr float columnSpacing = 0.55f;
+		static constexpr float rowSpacing = 0.6f;
+	};
+
+	struct Carom : Standard
+	{
+		static constexpr int ballCount = 3;
+		static constexpr int pocketCount = 0;
+	};
+
+	struct Stress : Standard
+	{
+		static constexpr float ballRadius = 0.03f;
+		static constexpr int ballCount = 4096;
+		static constexpr float columnSpacing = 0.075f;
+		static constexpr float rowSpacing = 0.08f;
+	};
+
+	struct Huge : Standard
+	{
+		static constexpr float ballRadius = 0.012f;
+		static constexpr int ballCount = 65536;
+		static constexpr float columnSpacing = 0.03f;
+		static constexpr float rowSpacing = 0.032f;
+	};
+}
+
+
+//-------------------------------------------------------
+//	table layouts
+//-------------------------------------------------------
+
+// inline room for a full pool rack and its pockets, bigger tables go to the heap
+template< class T >
+using TableArray = SmallVector< T, 16 >;
+
+
+template< class T, size_t Size >
+constexpr void resizeTo( std::array< T, Size >&, [[maybe_unused]] size_t size )
+{
+	assert( size == Size );
+}
+
+
+template< class T, size_t InlineCapacity >
+void resizeTo( SmallVector< T, InlineCapacity >& items, size_t size )
+{
+	items.resize( size );
+}
+
+
+// evenly spaced along both long cushions from corner to corner, 6 gives the usual table
+template< class Config, class Positions >
+constexpr Positions pocketLayout( int count )
+{
+	assert( count >= 0 && count % 2 == 0 );
+
+	Positions positions = {};
+	resizeTo( positions, size_t( count ) );
+	const int perSide = count / 2;
+	for ( int side = 0; side < 2; side++ )
+		for ( int i = 0; i < perSide; i++ )
 		{
-			// player ball
-			Vector2( -0.3f * width, 0.f ),
-			// other balls
-			Vector2( 0.2f * width, 0.f ),
-			Vector2( 0.25f * width, 0.05f * height ),
-			Vector2( 0.25f * width, -0.05f * height ),
-			Vector2( 0.3f * width, 0.1f * height ),
-			Vector2( 0.3f * width, 0.f ),
-			Vector2( 0.3f * width, -0.1f * height )
-		};
+			const float x = perSide > 1 ? ( float( i ) / float( perSide - 1 ) - 0.5f ) * Config::width : 0.f;
+			positions[ side * perSide + i ] = Vector2( x, ( float( side ) - 0.5f ) * Config::height );
+		}
+	return positions;
+}
+
+
+// cue ball first; the rack grows one ball per column from the head spot to the
+// cushion, the balls left over fill whole columns back towards the cue ball
+template< class Config, class Positions >
+constexpr Positions rackLayout( int count )
+{
+	assert( count >= 1 );
+
+	const float cueX = -0.3f * Config::width;
+	const float headX = 0.2f * Config::width;
+	const int maxPerColumn = int( ( Config::height - 2.f * Config::ballRadius ) / Config::rowSpacing ) + 1;
+	const int columnsToCushion = int( ( 0.5f * Config::width - Config::ballRadius - headX ) / Config::columnSpacing ) + 1;
+
+	Positions positions = {};
+	resizeTo( positions, size_t( count ) );
+	positions[ 0 ] = Vector2( cueX, 0.f );
+	int placed = 1;
+	for ( int column = 0; placed < count; column++ )
+	{
+		const bool isTriangle = column < columnsToCushion;
+		const float x = isTriangle ? headX + float( column ) * Config::columnSpacing : headX - float( column - columnsToCushion + 1 ) * Config::columnSpacing;
+		assert( x > cueX + 2.f * Config::columnSpacing && "more balls than the table holds" );
+
+		const int length = std::min( { isTriangle ? column + 1 : maxPerColumn, maxPerColumn, count - placed } );
+		for ( int row = 0; row < length; row++ )
+			positions[ placed++ ] = Vector2( x, ( 0.5f * float( length - 1 ) - float( row ) ) * Config::rowSpacing );
 	}
+	return positions;
+}
+
+
+// what the physics derives from the radii, squared so contacts need no square root
+template< class Config >
+struct Thresholds : Config
+{
+	static constexpr float contactDistanceSquared = 4.f * Config::ballRadius * Config::ballRadius;
+	static constexpr float pocketDistance = Config::pocketRadius + Config::ballRadius / 4.f;
+	static constexpr float pocketDistanceSquared = pocketDistance * pocketDistance;
+};
+
+
+// a variant's layout, fixed arrays with the rack and pockets computed by the compiler
+template< class Config >
+struct StaticLayout : Thresholds< Config >
+{
+	template< class T >
+	using BallArray = std::array< T, Config::ballCount >;
+	template< class T >
+	using PocketArray = std::array< T, Config::pocketCount >;
+
+	static constexpr BallArray< Vector2 > rack = rackLayout< Config, BallArray< Vector2 > >( Config::ballCount );
+	static constexpr PocketArray< Vector2 > pocketPositions = pocketLayout< Config, PocketArray< Vector2 > >( Config::pocketCount );
+};
 
-	namespace Ball
+
+// ball and pocket counts chosen at runtime on the standard table, the radii stay constant
+struct DynamicLayout : Thresholds< Params::Standard >
+{
+	template< class T >
+	using BallArray = TableArray< T >;
+	template< class T >
+	using PocketArray = TableArray< T >;
+
+	void setBallCount( int count )
 	{
-		constexpr float radius = 0.3f;
+		ballCount = count;
+		rack = rackLayout< Params::Standard, BallArray< Vector2 > >( count );
 	}
 
-	namespace Shot
+	void setPocketCount( int count )
 	{
-		constexpr float chargeTime = 1.f;
+		pocketCount = count;
+		pocketPositions = pocketLayout< Params::Standard, PocketArray< Vector2 > >( count );
+	}
+
+	int ballCount = Params::Standard::ballCount;
+	int pocketCount = Params::Standard::pocketCount;
+	BallArray< Vector2 > rack = rackLayout< Params::Standard, BallArray< Vector2 > >( ballCount );
+	PocketArray< Vector2 > pocketPositions = pocketLayout< Params::Standard, PocketArray< Vector2 > >( pocketCount );
+};
+
+
+//-------------------------------------------------------
+//	spatial order
+//-------------------------------------------------------
+
+// spreads the low 16 bits of v over the even bits
+constexpr uint32_t spreadBits( uint32_t v )
+{
+	v &= 0xffff;
+	v = ( v | v << 8 ) & 0x00ff00ff;
+	v = ( v | v << 4 ) & 0x0f0f0f0f;
+	v = ( v | v << 2 ) & 0x33333333;
+	v = ( v | v << 1 ) & 0x55555555;
+	return v;
+}
+
+
+// Z-order of a point on a width by height table centered on the origin:
+// points close on the table mostly get close codes
+uint32_t mortonCode( Vector2 const& position, float width, float height )
+{
+	const float x = std::min( std::max( position.x / width + 0.5f, 0.f ), 1.f );
+	const float y = std::min( std::max( position.y / height + 0.5f, 0.f ), 1.f );
+	return spreadBits( uint32_t( x * 65535.f ) ) | spreadBits( uint32_t( y * 65535.f ) ) << 1;
+}
+
+
+// uniform grid over the table listing the storage slots per cell, rebuilt every step
+// with counting sort; with storage in Morton order a cell's balls sit side by side
+class CellGrid
+{
+public:
+	void build( Vector2 const* positions, size_t count, float width, float height, float cellSize );
+
+	// every slot in the 3 by 3 cells around position
+	template< class Visit >
+	void forEachNear( Vector2 const& position, Visit&& visit ) const;
+
+private:
+	int cellColumn( float x ) const;
+	int cellRow( float y ) const;
+
+	int columns = 0;
+	int rows = 0;
+	float inverseCellSize = 0.f;
+	float left = 0.f;
+	float bottom = 0.f;
+	// slots of cell c are slots[ cellStart[ c ] ] up to slots[ cellStart[ c + 1 ] ]
+	std::vector< uint32_t > cellStart;
+	std::vector< uint32_t > slots;
+	std::vector< uint32_t > slotCells;
+	std::vector< uint32_t > cellCursor;
+};
+
+
+int CellGrid::cellColumn( float x ) const
+{
+	return std::min( std::max( int( ( x - left ) * inverseCellSize ), 0 ), columns - 1 );
+}
+
+
+int CellGrid::cellRow( float y ) const
+{
+	return std::min( std::max( int( ( y - bottom ) * inverseCellSize ), 0 ), rows - 1 );
+}
+
+
+void CellGrid::build( Vector2 const* positions, size_t count, float width, float height, float cellSize )
+{
+	columns = std::max( 1, int( std::ceil( width / cellSize ) ) );
+	rows = std::max( 1, int( std::ceil( height / cellSize ) ) );
+	inverseCellSize = 1.f / cellSize;
+	left = -0.5f * width;
+	bottom = -0.5f * height;
+
+	cellStart.assign( size_t( columns * rows ) + 1, 0 );
+	slotCells.resize( count );
+	for ( size_t i = 0; i < count; i++ )
+	{
+		slotCells[ i ] = uint32_t( cellRow( positions[ i ].y ) * columns + cellColumn( positions[ i ].x ) );
+		cellStart[ slotCells[ i ] + 1 ]++;
+	}
+	for ( size_t cell = 1; cell < cellStart.size(); cell++ )
+		cellStart[ cell ] += cellStart[ cell - 1 ];
+
+	slots.resize( count );
+	cellCursor.assign( cellStart.begin(), cellStart.end() - 1 );
+	for ( size_t i = 0; i < count; i++ )
+		slots[ cellCursor[ slotCells[ i ] ]++ ] = uint32_t( i );
+}
+
+
+template< class Visit >
+void CellGrid::forEachNear( Vector2 const& position, Visit&& visit ) const
+{
+	const int column = cellColumn( position.x );
+	const int row = cellRow( position.y );
+	for ( int y = std::max( row - 1, 0 ); y <= std::min( row + 1, rows - 1 ); y++ )
+	{
+		const uint32_t* cells = cellStart.data() + y * columns;
+		const uint32_t begin = cells[ std::max( column - 1, 0 ) ];
+		const uint32_t end = cells[ std::min( column + 1, columns - 1 ) + 1 ];
+		for ( uint32_t i = begin; i < end; i++ )
+			visit( size_t( slots[ i ] ) );
 	}
 }
 
@@ -159,42 +429,50 @@ namespace Params
 //	Table logic
 //-------------------------------------------------------
 
+template< class Layout >
 class Table
 {
 public:
+	using Balls = typename Layout::template BallArray< Scene::Mesh* >;
+
 	Table() = default;
 	Table( Table const& ) = delete;
 
-	void init();
+	void init( Layout const& layout );
 	void deinit();
 
-	const std::array< Scene::Mesh*, 7 >& getBalls() const;
+	// indexed by ball id
+	Balls& getBalls();
 
 private:
-	std::array< Scene::Mesh*, 6 > pockets = {};
-	std::array< Scene::Mesh*, 7 > balls = {};
+	typename Layout::template PocketArray< Scene::Mesh* > pockets = {};
+	Balls balls = {};
 };
 
 
-void Table::init()
+template< class Layout >
+void Table< Layout >::init( Layout const& layout )
 {
-	for ( int i = 0; i < 6; i++ )
+	resizeTo( pockets, size_t( layout.pocketCount ) );
+	for ( int i = 0; i < layout.pocketCount; i++ )
 	{
 		assert( !pockets[ i ] );
-		pockets[ i ] = Scene::createPocketMesh( Params::Table::pocketRadius );
-		Scene::placeMesh( pockets[ i ], Params::Table::pocketsPositions[ i ].x, Params::Table::pocketsPositions[ i ].y, 0.f );
+		pockets[ i ] = Scene::createPocketMesh( layout.pocketRadius );
+		Scene::placeMesh( pockets[ i ], layout.pocketPositions[ i ].x, layout.pocketPositions[ i ].y, 0.f );
 	}
 
-	for ( int i = 0; i < 7; i++ )
+	resizeTo( balls, size_t( layout.ballCount ) );
+	for ( int i = 0; i < layout.ballCount; i++ )
 	{
 		assert( !balls[ i ] );
-		balls[ i ] = Scene::createBallMesh( Params::Ball::radius );
-		Scene::placeMesh( balls[ i ], Params::Table::ballsPositions[ i ].x, Params::Table::ballsPositions[ i ].y, 0.f );
+		balls[ i ] = Scene::createBallMesh( layout.ballRadius );
+		Scene::placeMesh( balls[ i ], layout.rack[ i ].x, layout.rack[ i ].y, 0.f );
 	}
 }
 
 
-void Table::deinit()
+template< class Layout >
+void Table< Layout >::deinit()
 {
 	for ( Scene::Mesh* mesh : pockets )
 		Scene::destroyMesh( mesh );
@@ -205,238 +483,1075 @@ void Table::deinit()
 	balls = {};
 }
 
-const std::array< Scene::Mesh*, 7 >& Table::getBalls() const
+
+template< class Layout >
+typename Table< Layout >::Balls& Table< Layout >::getBalls()
 {
 	return balls;
 }
 
 
 //-------------------------------------------------------
-//	game public interface
+//	state hashing: Zobrist style, one key per ball id and
+//	cell; a random table per cell would be far too big,
+//	so the keys are mixed from the id and the cell instead
 //-------------------------------------------------------
 
-namespace Game
+// a ball's cell in the hash, both coordinates packed
+uint64_t hashCell( Vector2 const& position )
 {
-	Table table;
+	const int32_t x = int32_t( std::floor( position.x / Game::hashCellSize ) );
+	const int32_t y = int32_t( std::floor( position.y / Game::hashCellSize ) );
+	return uint64_t( uint32_t( x ) ) << 32 | uint32_t( y );
+}
 
-	bool isChargingShot = false;
-	float shotChargeProgress = 0.f;
 
-	const float infinity = 2 * (Params::Table::height + Params::Table::width);
-	const float impulse  = 6.0f;
-	const float friction = 0.03f;
+// no ball on the table is ever there
+constexpr uint64_t pocketedCell = ~uint64_t( 0 );
 
-	std::array< Vector2, 7 > ballPositions = {};
-	std::array< Vector2, 7 > ballVelocities = {};
 
-	void init()
+// the id and the cell through the splitmix64 finalizer
+uint64_t zobristKey( uint32_t id, uint64_t cell )
+{
+	return Hash::finalize( cell + 0x9e3779b97f4a7c15ull * ( uint64_t( id ) + 1 ) );
+}
+
+
+//-------------------------------------------------------
+//	Simulation: one instance per table variant, the game
+//	talks to whichever is active through this interface
+//-------------------------------------------------------
+
+class Simulation
+{
+public:
+	virtual ~Simulation();
+
+	// racks the balls and creates the table's meshes
+	virtual void init() = 0;
+	virtual void deinit() = 0;
+
+	// false when the cue ball dropped and the table needs a new rack
+	virtual bool physicLoop( float dt ) = 0;
+	virtual bool isFreeze() const = 0;
+
+	virtual Vector2 cueBallPosition() const = 0;
+	virtual Vector2 cueBallVelocity() const = 0;
+	virtual void strikeCueBall( Vector2 const& velocity ) = 0;
+
+	// every ball by id; a new state starts at rest
+	virtual void getState( Game::TableState& state ) const = 0;
+	virtual void setState( Game::TableState const& state ) = 0;
+	// the table's size, radii, ball count and pockets: equal for tables that play alike
+	virtual uint64_t getLayoutHash() const = 0;
+	// width and height of the playing surface
+	virtual Vector2 getTableSize() const = 0;
+
+	// tables of at least sortBallCount balls keep their storage in Morton order
+	void setBallSorting( bool isEnabled );
+	void setPhysics( Game::Physics const& physics );
+	// off screen tables neither create nor move meshes, set before init()
+	void setDrawn( bool isEnabled );
+
+	// ids in the order they dropped since init() or setState()
+	std::vector< int > const& getPocketed() const;
+	// Game::hashTable() of the current state, kept up as balls move and drop
+	uint64_t getStateHash() const;
+
+protected:
+	bool isSortingEnabled = true;
+	bool isDrawn = true;
+	std::vector< int > pocketed;
+	uint64_t stateHash = 0;
+	float friction = Game::Physics().friction;
+	float accurance = Game::Physics().accurance;
+	float accuranceSquared = accurance * accurance;
+};
+
+
+Simulation::~Simulation()
+{
+}
+
+
+void Simulation::setBallSorting( bool isEnabled )
+{
+	isSortingEnabled = isEnabled;
+}
+
+
+void Simulation::setPhysics( Game::Physics const& physics )
+{
+	friction = physics.friction;
+	accurance = physics.accurance;
+	accuranceSquared = accurance * accurance;
+}
+
+
+void Simulation::setDrawn( bool isEnabled )
+{
+	isDrawn = isEnabled;
+}
+
+
+std::vector< int > const& Simulation::getPocketed() const
+{
+	return pocketed;
+}
+
+
+uint64_t Simulation::getStateHash() const
+{
+	return stateHash;
+}
+
+
+template< class Layout >
+class TableSimulation final : public Simulation
+{
+public:
+	void init() override;
+	void deinit() override;
+	bool physicLoop( float dt ) override;
+	bool isFreeze() const override;
+	Vector2 cueBallPosition() const override;
+	Vector2 cueBallVelocity() const override;
+	void strikeCueBall( Vector2 const& velocity ) override;
+	void getState( Game::TableState& state ) const override;
+	void setState( Game::TableState const& state ) override;
+	uint64_t getLayoutHash() const override;
+	Vector2 getTableSize() const override;
+
+	Layout& getLayout();
+
+private:
+	using Vectors = typename Layout::template BallArray< Vector2 >;
+	using Ids = typename Layout::template BallArray< uint32_t >;
+
+	static constexpr float infinity = 2 * (Layout::height + Layout::width);
+	static constexpr uint32_t cueBallId = 0;
+	// storage order goes stale once the balls moved a diameter on average,
+	// one fast cue ball among thousands of resting ones hardly disturbs it
+	static constexpr float sortDistance = 2.f * Layout::ballRadius;
+
+	bool usesGrid() const;
+	bool sortsBalls() const;
+	void prepareGrid(float dt);
+	void sortBalls();
+
+	enum class StepResult
 	{
-		Engine::setTargetFPS( Params::System::targetFPS );
-		Scene::setupBackground( Params::Table::width, Params::Table::height );
-		table.init();
+		moved,
+		pocketed,
+		cueBallPocketed
+	};
+
+	float localStep(size_t i, float dt) const;
+	StepResult stepBall(size_t i, float dt);
+	StepResult catchUp(size_t i, float lag);
+	void markStruck(size_t i);
+
+	size_t findClosestBall(const Vector2& ballEndPosition, size_t subject) const;
+	void recalculateVelocities(size_t subject, size_t target);
+	float calculateTimeConflict(float distance, float velocityModule) const;
+	bool inPocket(const Vector2& ballEndPos) const;
+	void reduceVelocity(size_t i, float dt);
+	bool isBorderCollesion(const Vector2& ballPos, size_t i);
+	void pocketBall(size_t i);
+	void placeBall(size_t i);
+	void rehashBalls();
+
+	Layout layout;
+	Table< Layout > table;
+
+	Vectors ballPositions = {};
+	Vectors ballVelocities = {};
+	// how far each ball's clock is behind the simulation's, resting balls are never behind
+	typename Layout::template BallArray< float > ballLags = {};
+	// balls still on the table come first, pocketed ones are swapped behind them
+	size_t activeBalls = 0;
+	// ids of the balls given a new velocity since the last step, they don't wait for a local step
+	std::vector< uint32_t > struckIds;
+
+	// the arrays above are in storage order, which sorting changes; meshes and
+	// the cue ball are addressed by ball id, these map between the two
+	Ids ballIds = {};
+	Ids ballSlots = {};
+	// by ball id, the cell each is in stateHash at
+	typename Layout::template BallArray< uint64_t > hashCells = {};
+
+	CellGrid grid;
+	float gridCellSize = 0.f;
+	// mean distance the balls moved since the last sort
+	float travelSinceSort = 0.f;
+	std::vector< uint64_t > sortKeys;
+	std::vector< Vector2 > sortedPositions;
+	std::vector< Vector2 > sortedVelocities;
+	std::vector< float > sortedLags;
+	std::vector< uint32_t > sortedIds;
+};
 
-		ballPositions  = Params::Table::ballsPositions;
-		ballVelocities = {};
-	}
 
-	void deinit()
+template< class Layout >
+void TableSimulation< Layout >::init()
+{
+	if ( isDrawn )
+		Scene::setupBackground( layout.width, layout.height );
+
+	ballPositions  = layout.rack;
+	ballVelocities = {};
+	resizeTo( ballVelocities, ballPositions.size() );
+	ballLags       = {};
+	resizeTo( ballLags, ballPositions.size() );
+	activeBalls    = ballPositions.size();
+	struckIds.clear();
+	pocketed.clear();
+	if ( isDrawn )
+		table.init( layout );
+
+	resizeTo( ballIds, ballPositions.size() );
+	resizeTo( ballSlots, ballPositions.size() );
+	for ( size_t i = 0; i < ballPositions.size(); i++ )
 	{
+		ballIds[ i ] = uint32_t( i );
+		ballSlots[ i ] = uint32_t( i );
+	}
+	rehashBalls();
+	// sorted by the first step that moves anything
+	travelSinceSort = infinity;
+}
+
+
+template< class Layout >
+void TableSimulation< Layout >::deinit()
+{
+	if ( isDrawn )
 		table.deinit();
+}
+
+
+template< class Layout >
+Vector2 TableSimulation< Layout >::cueBallPosition() const
+{
+	return ballPositions[ballSlots[cueBallId]];
+}
+
+
+template< class Layout >
+Vector2 TableSimulation< Layout >::cueBallVelocity() const
+{
+	return ballVelocities[ballSlots[cueBallId]];
+}
+
+
+template< class Layout >
+void TableSimulation< Layout >::strikeCueBall( Vector2 const& velocity )
+{
+	ballVelocities[ballSlots[cueBallId]] = velocity;
+	markStruck( ballSlots[cueBallId] );
+}
+
+
+template< class Layout >
+void TableSimulation< Layout >::getState( Game::TableState& state ) const
+{
+	state.resize( ballPositions.size() );
+	for ( size_t slot = 0; slot < ballPositions.size(); slot++ )
+	{
+		Game::Ball& ball = state[ ballIds[ slot ] ];
+		ball.x = ballPositions[ slot ].x;
+		ball.y = ballPositions[ slot ].y;
+		ball.isPocketed = slot >= activeBalls;
 	}
+}
+
 
-	size_t findClosestBall(const Vector2& ballEndPosition, size_t subject)
+// balls on the table take the slots from the front in id order, pocketed ones from the back
+template< class Layout >
+void TableSimulation< Layout >::setState( Game::TableState const& state )
+{
+	assert( state.size() == ballPositions.size() );
+
+	size_t front = 0;
+	size_t back = state.size();
+	for ( size_t id = 0; id < state.size(); id++ )
 	{
-		size_t index = subject;
-		float distance = infinity;
+		const size_t slot = state[ id ].isPocketed ? --back : front++;
+		ballPositions[ slot ] = Vector2( state[ id ].x, state[ id ].y );
+		ballVelocities[ slot ] = { 0.f, 0.f };
+		ballLags[ slot ] = 0.f;
+		ballIds[ slot ] = uint32_t( id );
+		ballSlots[ id ] = uint32_t( slot );
+
+		if ( isDrawn )
+		{
+			Scene::setMeshVisible( table.getBalls()[ id ], !state[ id ].isPocketed );
+			placeBall( slot );
+		}
+	}
+	activeBalls = front;
+	struckIds.clear();
+	pocketed.clear();
+	rehashBalls();
+	travelSinceSort = infinity;
+}
 
-		for (size_t i = 0; i < ballPositions.size(); ++i) {
-			if (i == subject) {
-				continue;
-			}
-			if ((ballEndPosition - ballPositions[i]).length() < 2 * Params::Ball::radius)
-			{
-				float curr_distance = (ballPositions[subject] - ballPositions[i]).length();
-				if (curr_distance < distance) {
-					distance = curr_distance;
-					index = i;
-				}
+
+template< class Layout >
+uint64_t TableSimulation< Layout >::getLayoutHash() const
+{
+	uint64_t hash = Hash::mix( uint64_t( layout.ballCount ), uint64_t( layout.pocketCount ) );
+	for ( float value : { layout.width, layout.height, layout.ballRadius, layout.pocketRadius } )
+		hash = Hash::mix( hash, Hash::floatBits( value ) );
+	for ( int pocket = 0; pocket < layout.pocketCount; pocket++ )
+	{
+		hash = Hash::mix( hash, Hash::floatBits( layout.pocketPositions[ pocket ].x ) );
+		hash = Hash::mix( hash, Hash::floatBits( layout.pocketPositions[ pocket ].y ) );
+	}
+	return hash;
+}
+
+
+template< class Layout >
+Vector2 TableSimulation< Layout >::getTableSize() const
+{
+	return { layout.width, layout.height };
+}
+
+
+template< class Layout >
+Layout& TableSimulation< Layout >::getLayout()
+{
+	return layout;
+}
+
+
+template< class Layout >
+size_t TableSimulation< Layout >::findClosestBall(const Vector2& ballEndPosition, size_t subject) const
+{
+	size_t index = subject;
+	float distance = infinity;
+
+	auto consider = [&](size_t i) {
+		if (i == subject) {
+			return;
+		}
+		if ((ballEndPosition - ballPositions[i]).norm() < layout.contactDistanceSquared)
+		{
+			float curr_distance = (ballPositions[subject] - ballPositions[i]).length();
+			if (curr_distance < distance) {
+				distance = curr_distance;
+				index = i;
 			}
 		}
-		return index;
+	};
+
+	if (usesGrid()) {
+		grid.forEachNear(ballEndPosition, consider);
+	}
+	else {
+		for (size_t i = 0; i < activeBalls; ++i) {
+			consider(i);
+		}
 	}
+	return index;
+}
 
-	void recalculateVelocities(size_t subject, size_t target)
-	{
-		const auto& dir = (ballPositions[target] - ballPositions[subject]).normolize();
-		Vector2 tan = { dir.y, dir.x };
-		
-		auto dirSubjectVel = ballVelocities[subject] * dir;
-		auto dirTargetVel = ballVelocities[target] * dir;
 
-		auto tanSubjectVel = ballVelocities[subject] - dir * dirSubjectVel;
-		auto tanTargetVel = ballVelocities[target] - dir * dirTargetVel;
+template< class Layout >
+void TableSimulation< Layout >::recalculateVelocities(size_t subject, size_t target)
+{
+	const Vector2 dir = (ballPositions[target] - ballPositions[subject]).normolize();
+	Vector2 tan = { dir.y, dir.x };
+
+	auto dirSubjectVel = ballVelocities[subject] * dir;
+	auto dirTargetVel = ballVelocities[target] * dir;
+
+	auto tanSubjectVel = ballVelocities[subject] - dir * dirSubjectVel;
+	auto tanTargetVel = ballVelocities[target] - dir * dirTargetVel;
+
+	ballVelocities[subject] = tanSubjectVel + dir * dirTargetVel;
+	ballVelocities[target] = tanTargetVel + dir * dirSubjectVel;
+	markStruck(subject);
+	markStruck(target);
+}
+
+
+// a ball's local step follows its speed, one with a new velocity is brought to the
+// simulation's clock at the end of the step instead of waiting for a whole local step
+template< class Layout >
+void TableSimulation< Layout >::markStruck(size_t i)
+{
+	struckIds.push_back(ballIds[i]);
+}
+
+
+template< class Layout >
+float TableSimulation< Layout >::calculateTimeConflict(float distance, float velocityModule) const
+{
+	return (distance - 2 * layout.ballRadius) / velocityModule;
+}
+
+
+template< class Layout >
+bool TableSimulation< Layout >::inPocket(const Vector2& ballEndPos) const
+{
+	for (const auto& pocketPos : layout.pocketPositions) {
+		if ((ballEndPos - pocketPos).norm() <= layout.pocketDistanceSquared) {
+			return true;
+		}
+	}
+	return false;
+}
+
 
-		ballVelocities[subject] = tanSubjectVel + dir * dirTargetVel;
-		ballVelocities[target] = tanTargetVel + dir * dirSubjectVel;
+template< class Layout >
+void TableSimulation< Layout >::reduceVelocity(size_t i, float dt)
+{
+	auto& velocity = ballVelocities[i];
+
+	if (velocity.norm() < accuranceSquared) {
+		return;
 	}
 
-	float calculateTimeConflict(float distance, float velocityModule)
-	{
-		return (distance - 2 * Params::Ball::radius) / velocityModule;
+	bool isVxPositive = velocity.x >= 0.f;
+	bool isVyPositive = velocity.y >= 0.f;
+
+	velocity.x -= isVxPositive ? friction * dt * 9.81f : -friction * dt * 9.81f;
+	velocity.y -= isVyPositive ? friction * dt * 9.81f : -friction * dt * 9.81f;
+
+	if (velocity.x < 0.f && isVxPositive ||
+		velocity.x > 0.f && !isVxPositive) {
+		velocity.x = 0.f;
+	}
+	if (velocity.y < 0.f && isVyPositive ||
+		velocity.y > 0.f && !isVyPositive) {
+		velocity.y = 0.f;
 	}
+}
 
-	bool inPocket(const Vector2& ballEndPos)
-	{
-		for (const auto& pocketPos : Params::Table::pocketsPositions) {
-			if ((ballEndPos - pocketPos).length() <= Params::Table::pocketRadius + Params::Ball::radius / 4.f) {
-				return true;
-			}
+
+template< class Layout >
+bool TableSimulation< Layout >::isBorderCollesion(const Vector2& ballPos, size_t i)
+{
+	bool borderCollesion = false;
+	const float cushionDistance = layout.ballRadius + accurance;
+	if (abs(abs(ballPos.x) - layout.width / 2.f) <= cushionDistance) {
+		ballVelocities[i].x = -ballVelocities[i].x;
+		borderCollesion = true;
+	}
+	if (abs(abs(ballPos.y) - layout.height / 2.f) <= cushionDistance) {
+		ballVelocities[i].y = -ballVelocities[i].y;
+		borderCollesion = true;
+	}
+	return borderCollesion;
+}
+
+
+template< class Layout >
+bool TableSimulation< Layout >::isFreeze() const
+{
+	for (size_t i = 0; i < activeBalls; ++i) {
+		if (ballVelocities[i].norm() >= accuranceSquared) {
+			return false;
 		}
-		return false;
 	}
+	return true;
+}
 
-	void reduceVelocities(float dt)
-	{
-		for (auto& velocity : ballVelocities) {
-			
-			if (velocity.length() < Params::System::accurance) {
-				continue;
-			}
 
-			bool isVxPositive = velocity.x >= 0.f;
-			bool isVyPositive = velocity.y >= 0.f;
-			
-			velocity.x -= isVxPositive ? friction * dt * 9.81f : -friction * dt * 9.81f;
-			velocity.y -= isVyPositive ? friction * dt * 9.81f : -friction * dt * 9.81f;
+// moves ball i out of the active range, the last active ball takes its place
+template< class Layout >
+void TableSimulation< Layout >::pocketBall(size_t i)
+{
+	const size_t last = --activeBalls;
+
+	const uint32_t id = ballIds[i];
+	pocketed.push_back(int(id));
+	stateHash ^= zobristKey(id, hashCells[id]) ^ zobristKey(id, pocketedCell);
+	hashCells[id] = pocketedCell;
+	if (isDrawn) {
+		Scene::setMeshVisible(table.getBalls()[id], false);
+	}
+	std::swap(ballPositions[i], ballPositions[last]);
+	std::swap(ballVelocities[i], ballVelocities[last]);
+	std::swap(ballLags[i], ballLags[last]);
+	std::swap(ballIds[i], ballIds[last]);
+	ballSlots[ballIds[i]] = uint32_t(i);
+	ballSlots[ballIds[last]] = uint32_t(last);
+	ballVelocities[last] = { 0.f, 0.f };
+	ballLags[last] = 0.f;
+
+	// slots changed, the grid must not list the pocketed one
+	if (usesGrid()) {
+		grid.build(ballPositions.data(), activeBalls, layout.width, layout.height, gridCellSize);
+	}
+}
 
-			if (velocity.x < 0.f && isVxPositive ||
-				velocity.x > 0.f && !isVxPositive) {
-				velocity.x = 0.f;
-			}
-			if (velocity.y < 0.f && isVyPositive ||
-				velocity.y > 0.f && !isVyPositive) {
-				velocity.y = 0.f;
-			}
+
+// every move of a ball ends here: the hash follows it from cell to cell, the mesh when drawn
+template< class Layout >
+void TableSimulation< Layout >::placeBall(size_t i)
+{
+	const uint32_t id = ballIds[i];
+	const uint64_t cell = hashCell(ballPositions[i]);
+	if (cell != hashCells[id]) {
+		stateHash ^= zobristKey(id, hashCells[id]) ^ zobristKey(id, cell);
+		hashCells[id] = cell;
+	}
+	if (isDrawn) {
+		Scene::placeMesh(table.getBalls()[id], ballPositions[i].x, ballPositions[i].y, 0.f);
+	}
+}
+
+
+// the hash from scratch, after the whole table was set
+template< class Layout >
+void TableSimulation< Layout >::rehashBalls()
+{
+	resizeTo(hashCells, ballPositions.size());
+	stateHash = 0;
+	for (size_t i = 0; i < ballPositions.size(); ++i) {
+		const uint32_t id = ballIds[i];
+		hashCells[id] = i < activeBalls ? hashCell(ballPositions[i]) : pocketedCell;
+		stateHash ^= zobristKey(id, hashCells[id]);
+	}
+}
+
+
+template< class Layout >
+bool TableSimulation< Layout >::usesGrid() const
+{
+	return layout.ballCount >= Params::System::gridBallCount;
+}
+
+
+template< class Layout >
+bool TableSimulation< Layout >::sortsBalls() const
+{
+	return isSortingEnabled && layout.ballCount >= Params::System::sortBallCount;
+}
+
+
+// the grid lists balls where they are at the start of the step, its cells are big enough to
+// still hold every contact after the balls moved, with margin for balls pushed more than once
+// and for the half radius local step a lagging ball may add
+template< class Layout >
+void TableSimulation< Layout >::prepareGrid(float dt)
+{
+	float maxSpeedSquared = 0.f;
+	float speedSum = 0.f;
+	for (size_t i = 0; i < activeBalls; ++i) {
+		const float speedSquared = ballVelocities[i].norm();
+		maxSpeedSquared = std::max(maxSpeedSquared, speedSquared);
+		speedSum += speedSquared > 0.f ? std::sqrt(speedSquared) : 0.f;
+	}
+	const float maxTravel = std::sqrt(maxSpeedSquared) * dt;
+
+	// a busy table resorts every few steps, one coming to rest hardly ever
+	travelSinceSort += speedSum * dt / float(activeBalls);
+	if (sortsBalls() && travelSinceSort > sortDistance) {
+		sortBalls();
+	}
+
+	gridCellSize = 3.f * layout.ballRadius + 4.f * maxTravel;
+	grid.build(ballPositions.data(), activeBalls, layout.width, layout.height, gridCellSize);
+}
+
+
+// puts the active balls in Morton order of their positions, so balls near on the
+// table are near in memory and the grid's neighbour queries stay in few cache lines
+template< class Layout >
+void TableSimulation< Layout >::sortBalls()
+{
+	sortKeys.resize(activeBalls);
+	for (size_t i = 0; i < activeBalls; ++i) {
+		sortKeys[i] = uint64_t(mortonCode(ballPositions[i], layout.width, layout.height)) << 32 | i;
+	}
+	std::sort(sortKeys.begin(), sortKeys.end());
+
+	sortedPositions.resize(activeBalls);
+	sortedVelocities.resize(activeBalls);
+	sortedLags.resize(activeBalls);
+	sortedIds.resize(activeBalls);
+	for (size_t i = 0; i < activeBalls; ++i) {
+		const size_t slot = size_t(sortKeys[i] & 0xffffffff);
+		sortedPositions[i] = ballPositions[slot];
+		sortedVelocities[i] = ballVelocities[slot];
+		sortedLags[i] = ballLags[slot];
+		sortedIds[i] = ballIds[slot];
+	}
+	for (size_t i = 0; i < activeBalls; ++i) {
+		ballPositions[i] = sortedPositions[i];
+		ballVelocities[i] = sortedVelocities[i];
+		ballLags[i] = sortedLags[i];
+		ballIds[i] = sortedIds[i];
+		ballSlots[ballIds[i]] = uint32_t(i);
+	}
+	travelSinceSort = 0.f;
+}
+
+
+// fast balls step often and short, slow ones once per simulation step
+template< class Layout >
+float TableSimulation< Layout >::localStep(size_t i, float dt) const
+{
+	const float speed = ballVelocities[i].length();
+	return std::min(Params::System::localStepRadii * layout.ballRadius / speed, dt);
+}
+
+
+// steps a ball that lags behind the given lag in its own local steps, pockets, cushions
+// and contacts included, until it meets that clock, comes to rest or drops; the ball is
+// followed by id, a ball pocketed on the way moves others between slots
+template< class Layout >
+typename TableSimulation< Layout >::StepResult TableSimulation< Layout >::catchUp(size_t i, float lag)
+{
+	const uint32_t id = ballIds[i];
+	for (;;) {
+		i = ballSlots[id];
+		if (i >= activeBalls || ballVelocities[i].norm() <= accuranceSquared) {
+			return StepResult::moved;
+		}
+		const float behind = ballLags[i] - lag;
+		if (behind <= 0.f) {
+			return StepResult::moved;
+		}
+
+		const float step = localStep(i, behind);
+		const StepResult result = stepBall(i, step);
+		if (result != StepResult::moved) {
+			return result;
+		}
+		if (step == behind) {
+			// rounding must not leave a sliver to catch up again
+			i = ballSlots[id];
+			ballLags[i] = std::min(ballLags[i], lag);
+			return StepResult::moved;
 		}
 	}
+}
 
-	bool isBorderCollesion(const Vector2& ballPos, size_t i)
-	{
-		bool borderCollesion = false;
-		if (abs(abs(ballPos.x) - Params::Table::width / 2.f) <= Params::Ball::radius + Params::System::accurance) {
-			ballVelocities[i].x = -ballVelocities[i].x;
-			borderCollesion = true;
+
+// advances ball i by its own dt, any ball in the way is first brought to its clock
+template< class Layout >
+typename TableSimulation< Layout >::StepResult TableSimulation< Layout >::stepBall(size_t i, float dt)
+{
+	Vector2 ballEndPos = {
+					ballPositions[i].x + ballVelocities[i].x * dt,
+					ballPositions[i].y + ballVelocities[i].y * dt };
+
+	if (inPocket(ballEndPos)) {
+		if (ballIds[i] == cueBallId) {
+			return StepResult::cueBallPocketed;
 		}
-		if (abs(abs(ballPos.y) - Params::Table::height / 2.f) <= Params::Ball::radius + Params::System::accurance) {
-			ballVelocities[i].y = -ballVelocities[i].y;
-			borderCollesion = true;
+		pocketBall(i);
+		return StepResult::pocketed;
+	}
+
+	// synchronize: a moving target still behind where the subject starts this step catches up
+	// first, then the step starts over, the target may have moved off or hit the subject
+	size_t j = findClosestBall(ballEndPos, i);
+	if (j != i && ballLags[j] > ballLags[i] && ballVelocities[j].norm() > accuranceSquared) {
+		const uint32_t id = ballIds[i];
+		if (catchUp(j, ballLags[i]) == StepResult::cueBallPocketed) {
+			return StepResult::cueBallPocketed;
 		}
-		return borderCollesion;
+		return stepBall(ballSlots[id], dt);
 	}
-	
-	bool isFreeze()
-	{
-		for (const auto& velocities : ballVelocities) {
-			if (velocities.length() < Params::System::accurance) {
+
+	ballLags[i] -= dt;
+	if (isBorderCollesion(ballEndPos, i)) {
+		reduceVelocity(i, dt);
+		return StepResult::moved;
+	}
+
+	if (j == i) {
+		ballPositions[i] = ballEndPos;
+		placeBall(i);
+		reduceVelocity(i, dt);
+
+		return StepResult::moved;
+	}
+
+	const bool isTargetResting = ballVelocities[j].norm() <= accuranceSquared;
+
+	// calc approximated [dt << 1] subject position when conflict
+	float distance = (ballPositions[i] - ballPositions[j]).length();
+	float dtau = calculateTimeConflict(distance, ballVelocities[i].length());
+	Vector2 conflictSubjectPos = { ballPositions[i].x + ballVelocities[i].x * dtau,
+								   ballPositions[i].y + ballVelocities[i].y * dtau };
+
+	// calc new position
+	recalculateVelocities(i, j);
+	ballPositions[i] = { conflictSubjectPos.x + ballVelocities[i].x * (dt - dtau),
+						 conflictSubjectPos.y + ballVelocities[i].y * (dt - dtau) };
+	ballPositions[j] = { ballPositions[j].x + ballVelocities[j].x * (dt - dtau),
+						 ballPositions[j].y + ballVelocities[j].y * (dt - dtau) };
+
+	placeBall(i);
+	placeBall(j);
+
+	// both now share the subject's clock, unless a moving target was already ahead;
+	// a resting one's lag holds no time of its own and is taken over outright
+	ballLags[j] = isTargetResting ? ballLags[i] : std::min(ballLags[j], ballLags[i]);
+	reduceVelocity(i, dt);
+	reduceVelocity(j, dt);
+	return StepResult::moved;
+}
+
+
+template< class Layout >
+bool TableSimulation< Layout >::physicLoop(float dt)
+{
+	if (isFreeze()) {
+		return true;
+	}
+
+	if (usesGrid()) {
+		prepareGrid(dt);
+	}
+
+	for (size_t i = 0; i < activeBalls; ++i) {
+		if (ballVelocities[i].norm() <= accuranceSquared) {
+			ballLags[i] = 0.f;
+		}
+		else {
+			ballLags[i] += dt;
+		}
+	}
+
+	for (size_t i = 0; i < activeBalls; ++i) {
+		// steps while the ball is a whole local step behind, the rest waits for the next
+		// step; a local step is never longer than dt, so every moving ball advances
+		while (ballVelocities[i].norm() > accuranceSquared) {
+			const float step = localStep(i, dt);
+			if (ballLags[i] < step) {
+				break;
+			}
+
+			const StepResult result = stepBall(i, step);
+			if (result == StepResult::cueBallPocketed) {
 				return false;
 			}
+			if (result == StepResult::pocketed) {
+				// the ball swapped in from the end has not moved yet
+				--i;
+				break;
+			}
 		}
-		return true;
 	}
 
-	void physicLoop(float dt)
-	{
-		if (isFreeze()) {
-			return;
+	// balls that got a new velocity move with it in this step, catching up may strike more
+	for (size_t k = 0; k < struckIds.size(); ++k) {
+		if (catchUp(ballSlots[struckIds[k]], 0.f) == StepResult::cueBallPocketed) {
+			struckIds.clear();
+			return false;
 		}
+	}
+	struckIds.clear();
+	return true;
+}
 
-		const auto& balls = table.getBalls();
-		std::unordered_set<size_t> undoneBalls;
-		for (size_t i = 0; i < ballVelocities.size(); ++i) {
-			
-			if (ballVelocities[i].length() <= Params::System::accurance ||
-				undoneBalls.find(i) != undoneBalls.end()) {
-				continue;
-			}
 
-			Vector2 ballEndPos = {
-							ballPositions[i].x + ballVelocities[i].x * dt,
-							ballPositions[i].y + ballVelocities[i].y * dt };
-			
-			if (inPocket(ballEndPos)) {
-				if (i == 0) {
-					deinit();
-					init();
+//-------------------------------------------------------
+//	game public interface
+//-------------------------------------------------------
 
-					return;
-				}
+namespace Game
+{
+	TableSimulation< StaticLayout< Params::Standard > > standardSimulation;
+	TableSimulation< StaticLayout< Params::Pool > > poolSimulation;
+	TableSimulation< StaticLayout< Params::Snooker > > snookerSimulation;
+	TableSimulation< StaticLayout< Params::Carom > > caromSimulation;
+	TableSimulation< StaticLayout< Params::Stress > > stressSimulation;
+	TableSimulation< StaticLayout< Params::Huge > > hugeSimulation;
+	TableSimulation< DynamicLayout > customSimulation;
+
+	Variant variant = Variant::standard;
+	// the one racked by init(), a new variant takes over at the next init()
+	Simulation* simulation = &standardSimulation;
 
-				ballPositions[i] = { infinity, infinity };
-				ballVelocities[i] = { 0.f, 0.f };
-				Scene::placeMesh(balls[i], ballPositions[i].x, ballPositions[i].y, 0.f);
+	bool isChargingShot = false;
+	float shotChargeProgress = 0.f;
+	// latency trace of the shot until the cue ball starts moving
+	uint32_t shotTraceId = 0;
 
-				continue;
-			}
-						
-			if (isBorderCollesion(ballEndPos, i)) {
-				continue;
-			}
+	Physics physics;
 
-			size_t j = findClosestBall(ballEndPos, i);
-			if (j == i) {
-				ballPositions[i] = ballEndPos;
-				Scene::placeMesh(balls[i], ballPositions[i].x, ballPositions[i].y, 0.f);
+	Simulation& selectSimulation()
+	{
+		switch ( variant )
+		{
+			case Variant::pool:
+				return poolSimulation;
+			case Variant::snooker:
+				return snookerSimulation;
+			case Variant::carom:
+				return caromSimulation;
+			case Variant::stress:
+				return stressSimulation;
+			case Variant::huge:
+				return hugeSimulation;
+			case Variant::custom:
+				return customSimulation;
+			case Variant::standard:
+				break;
+		}
+		return standardSimulation;
+	}
 
-				continue;
-			}
+	void init()
+	{
+		Engine::setTargetFPS( Params::System::targetFPS );
+		Engine::setSimulationRate( Params::System::simulationRate );
+
+		simulation = &selectSimulation();
+		simulation->init();
+	}
+
+	void deinit()
+	{
+		simulation->deinit();
+	}
 
-			// calc approximated [dt << 1] subject position when conflict
-			float distance = (ballPositions[i] - ballPositions[j]).length();
-			float dtau = calculateTimeConflict(distance, ballVelocities[i].length());
-			Vector2 conflictSubjectPos = { ballPositions[i].x + ballVelocities[i].x * dtau,
-										   ballPositions[i].y + ballVelocities[i].y * dtau };
-			
-			// calc new position
-			recalculateVelocities(i, j);
-			ballPositions[i] = { conflictSubjectPos.x + ballVelocities[i].x * (dt - dtau),
-								 conflictSubjectPos.y + ballVelocities[i].y * (dt - dtau) };
-			ballPositions[j] = { ballPositions[j].x + ballVelocities[j].x * (dt - dtau),
-								 ballPositions[j].y + ballVelocities[j].y * (dt - dtau) };
-
-			Scene::placeMesh(balls[i], ballPositions[i].x, ballPositions[i].y, 0.f);
-			Scene::placeMesh(balls[j], ballPositions[j].x, ballPositions[j].y, 0.f);
-
-			undoneBalls.insert({ i, j });
+	void processInput()
+	{
+		Input::Event event;
+		while ( Engine::pollInputEvent( event ) )
+		{
+			switch ( event.type )
+			{
+				case Input::Type::mouseButtonPressed:
+					mouseButtonPressed( event.x, event.y );
+					break;
+				case Input::Type::mouseButtonReleased:
+					Latency::mark( event.id, Latency::Stage::applied );
+					mouseButtonReleased( event.x, event.y, event.id );
+					break;
+				case Input::Type::restart:
+					deinit();
+					init();
+					break;
+			}
 		}
-		reduceVelocities(dt);
 	}
 
 	void update( float dt )
 	{
-		physicLoop(dt);
+		// input is applied at the start of a step only, which keeps replays deterministic
+		processInput();
+
+		const Vector2 cueBallPosition = simulation->cueBallPosition();
+		if ( !simulation->physicLoop( dt ) )
+		{
+			deinit();
+			init();
+		}
+		// the engine marks the shot simulated once this step is done
+		if ( shotTraceId && ( simulation->cueBallPosition() - cueBallPosition ).norm() > 0.f )
+		{
+			Scene::traceFrame( shotTraceId );
+			shotTraceId = 0;
+		}
+
 		if ( isChargingShot )
 			shotChargeProgress = std::min( shotChargeProgress + dt / Params::Shot::chargeTime, 1.f );
 		Scene::updateProgressBar( shotChargeProgress );
 	}
 
+	void setVariant( Variant newVariant )
+	{
+		variant = newVariant;
+	}
+
+	void setBallSorting( bool isEnabled )
+	{
+		for ( Simulation* table : std::initializer_list< Simulation* >{ &standardSimulation, &poolSimulation, &snookerSimulation, &caromSimulation, &stressSimulation, &hugeSimulation, &customSimulation } )
+			table->setBallSorting( isEnabled );
+	}
+
+	void setPhysics( Physics const& newPhysics )
+	{
+		physics = newPhysics;
+		for ( Simulation* table : std::initializer_list< Simulation* >{ &standardSimulation, &poolSimulation, &snookerSimulation, &caromSimulation, &stressSimulation, &hugeSimulation, &customSimulation } )
+			table->setPhysics( physics );
+	}
+
+	Physics getPhysics()
+	{
+		return physics;
+	}
+
+	void setBallCount( int count )
+	{
+		assert( count >= 1 );
+		customSimulation.getLayout().setBallCount( count );
+		variant = Variant::custom;
+	}
+
+	void setPocketCount( int count )
+	{
+		assert( count >= 0 && count % 2 == 0 );
+		customSimulation.getLayout().setPocketCount( count );
+		variant = Variant::custom;
+	}
+
+	bool isQuiescent()
+	{
+		return simulation->isFreeze() && !isChargingShot;
+	}
+
 	void mouseButtonPressed( float x, float y )
 	{
 		isChargingShot = true;
 	}
 
-	void mouseButtonReleased( float x, float y )
+	void mouseButtonReleased( float x, float y, uint32_t traceId )
 	{
 		// TODO: implement billiard logic here
-		 
+
 		// New shot can't be done while all balls are in motion;
-		if (ballVelocities[0].length() < 0.01f) {
-			ballVelocities[0] = { x - ballPositions[0].x, 
-								  y - ballPositions[0].y };
-			ballVelocities[0].normolize();
-			ballVelocities[0] *= impulse * shotChargeProgress;
+		if (simulation->cueBallVelocity().length() < 0.01f) {
+			const Vector2 cueBallPosition = simulation->cueBallPosition();
+			Vector2 velocity = { x - cueBallPosition.x,
+								 y - cueBallPosition.y };
+			velocity.normolize();
+			velocity *= physics.impulse * shotChargeProgress;
+			simulation->strikeCueBall(velocity);
+			shotTraceId = traceId;
 		}
 
 		isChargingShot = false;
 		shotChargeProgress = 0.f;
 	}
+
+	std::unique_ptr< Simulation > createSimulation( Variant variant )
+	{
+		switch ( variant )
+		{
+			case Variant::pool:
+				return std::unique_ptr< Simulation >( new TableSimulation< StaticLayout< Params::Pool > > );
+			case Variant::snooker:
+				return std::unique_ptr< Simulation >( new TableSimulation< StaticLayout< Params::Snooker > > );
+			case Variant::carom:
+				return std::unique_ptr< Simulation >( new TableSimulation< StaticLayout< Params::Carom > > );
+			case Variant::stress:
+				return std::unique_ptr< Simulation >( new TableSimulation< StaticLayout< Params::Stress > > );
+			case Variant::huge:
+				return std::unique_ptr< Simulation >( new TableSimulation< StaticLayout< Params::Huge > > );
+			case Variant::custom:
+			{
+				TableSimulation< DynamicLayout >* custom = new TableSimulation< DynamicLayout >;
+				custom->getLayout() = customSimulation.getLayout();
+				return std::unique_ptr< Simulation >( custom );
+			}
+			case Variant::standard:
+				break;
+		}
+		return std::unique_ptr< Simulation >( new TableSimulation< StaticLayout< Params::Standard > > );
+	}
+
+	uint64_t hashBall( int id, Ball const& ball )
+	{
+		return zobristKey( uint32_t( id ), ball.isPocketed ? pocketedCell : hashCell( Vector2( ball.x, ball.y ) ) );
+	}
+
+	uint64_t hashTable( TableState const& state )
+	{
+		uint64_t hash = 0;
+		for ( size_t id = 0; id < state.size(); id++ )
+			hash ^= hashBall( int( id ), state[ id ] );
+		return hash;
+	}
+
+	// an id no ball has
+	uint64_t hashGameState( uint32_t value )
+	{
+		return zobristKey( ~uint32_t( 0 ), value );
+	}
+
+	ShotSimulator::ShotSimulator( Variant variant ) :
+		simulation( createSimulation( variant ) )
+	{
+		simulation->setDrawn( false );
+		simulation->init();
+		simulation->getState( rackState );
+	}
+
+	ShotSimulator::~ShotSimulator()
+	{
+		simulation->deinit();
+	}
+
+	void ShotSimulator::setPhysics( Physics const& newPhysics )
+	{
+		physics = newPhysics;
+		simulation->setPhysics( physics );
+	}
+
+	void ShotSimulator::setBallSorting( bool isEnabled )
+	{
+		simulation->setBallSorting( isEnabled );
+	}
+
+	Physics const& ShotSimulator::getPhysics() const
+	{
+		return physics;
+	}
+
+	TableState const& ShotSimulator::rack() const
+	{
+		return rackState;
+	}
+
+	uint64_t ShotSimulator::layoutHash() const
+	{
+		return simulation->getLayoutHash();
+	}
+
+	float ShotSimulator::tableWidth() const
+	{
+		return simulation->getTableSize().x;
+	}
+
+	float ShotSimulator::tableHeight() const
+	{
+		return simulation->getTableSize().y;
+	}
+
+	// the game's fixed steps from the start state until every ball stopped
+	ShotOutcome ShotSimulator::simulate( TableState const& start, Shot const& shot )
+	{
+		ShotOutcome outcome;
+		simulation->setState( start );
+
+		Vector2 velocity = { shot.directionX, shot.directionY };
+		velocity.normolize();
+		velocity *= physics.impulse * std::min( std::max( shot.power, 0.f ), 1.f );
+		simulation->strikeCueBall( velocity );
+
+		const float stepTime = 1.f / float( Params::System::simulationRate );
+		while ( !simulation->isFreeze() && outcome.steps < Params::Shot::maxSteps )
+		{
+			outcome.steps++;
+			if ( !simulation->physicLoop( stepTime ) )
+			{
+				outcome.isScratch = true;
+				break;
+			}
+		}
+
+		simulation->getState( outcome.rest );
+		outcome.pocketed = simulation->getPocketed();
+		outcome.hash = simulation->getStateHash();
+		if ( outcome.isScratch )
+		{
+			outcome.hash ^= hashBall( 0, outcome.rest[ 0 ] );
+			outcome.rest[ 0 ].isPocketed = true;
+			outcome.hash ^= hashBall( 0, outcome.rest[ 0 ] );
+			outcome.pocketed.push_back( 0 );
+		}
+		return outcome;
+	}
 }
@@ -1,10 +1,25 @@
 
 
+#include <cstdio>
+#include <cstring>
+
 #include "../framework/engine.hpp"
 
 
-int main()
+int main( int argc, char* argv[] )
 {
+	if ( argc == 3 && std::strcmp( argv[ 1 ], "--record" ) == 0 )
+		Engine::recordReplay( argv[ 2 ] );
+	else if ( argc == 2 && std::strncmp( argv[ 1 ], "--", 2 ) == 0 && !Engine::selectMode( argv[ 1 ] + 2 ) )
+	{
+		std::printf( "unknown option %s\n", argv[ 1 ] );
+		return 1;
+	}
+
 	Engine::run();
-	return 0;
+
+	Clock::FrameStats stats = Engine::getFrameStats();
+	std::printf( "frames: %d, mean: %.3f ms, jitter: %.3f ms, max overshoot: %.3f ms\n",
+		stats.frames, stats.meanFrameTime * 1e3, stats.frameTimeStdDev * 1e3, stats.maxOvershoot * 1e3 );
+	return Engine::getExitCode();
 }
@@ -0,0 +1,797 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "../framework/clock.hpp"
+#include "../framework/frame.hpp"
+#include "../framework/game.hpp"
+#include "../framework/gl_state.hpp"
+#include "../framework/raster.hpp"
+#include "../framework/scene.hpp"
+#include "../framework/shot_cache.hpp"
+#include "../framework/thread_pool.hpp"
+
+
+//-------------------------------------------------------
+//	scenarios
+//-------------------------------------------------------
+
+namespace
+{
+	// the game's own table and rate
+	constexpr float tableWidth = 15.f;
+	constexpr float tableHeight = 8.f;
+	constexpr float ballRadius = 0.3f;
+	constexpr float stepTime = 1.f / 30.f;
+	// a shot that never comes to rest is a bug, not a slow shot
+	constexpr int maxStepsPerShot = 100000;
+
+	constexpr int frameWidth = 1280;
+	constexpr int frameHeight = 720;
+
+
+	struct Summary
+	{
+		int samples = 0;
+		double min = 0.0;
+		double median = 0.0;
+		double mean = 0.0;
+		double stdDev = 0.0;
+		double p95 = 0.0;
+		// per sample, negative when not counted
+		double cacheMisses = -1.0;
+	};
+
+
+	// timings in microseconds, every scenario keeps its samples in run order
+	struct Result
+	{
+		std::string name;
+		std::vector< double > samples;
+		double cacheMisses = 0.0;
+		int countedSamples = 0;
+	};
+
+
+	// L1 data cache read misses of this thread, the working sets measured here mostly
+	// fit the outer caches; unavailable without a PMU the kernel lets us read
+	class CacheMissCounter
+	{
+	public:
+		CacheMissCounter();
+		~CacheMissCounter();
+
+		bool isAvailable() const;
+		uint64_t read() const;
+
+	private:
+		int descriptor = -1;
+	};
+
+
+#ifdef __linux__
+	CacheMissCounter::CacheMissCounter()
+	{
+		perf_event_attr attributes = {};
+		attributes.size = sizeof( attributes );
+		attributes.type = PERF_TYPE_HW_CACHE;
+		attributes.config = PERF_COUNT_HW_CACHE_L1D | PERF_COUNT_HW_CACHE_OP_READ << 8 | PERF_COUNT_HW_CACHE_RESULT_MISS << 16;
+		attributes.exclude_kernel = 1;
+		attributes.exclude_hv = 1;
+		descriptor = int( syscall( SYS_perf_event_open, &attributes, 0, -1, -1, 0 ) );
+	}
+
+
+	CacheMissCounter::~CacheMissCounter()
+	{
+		if ( descriptor >= 0 )
+			close( descriptor );
+	}
+
+
+	uint64_t CacheMissCounter::read() const
+	{
+		uint64_t count = 0;
+		if ( descriptor < 0 || ::read( descriptor, &count, sizeof( count ) ) != sizeof( count ) )
+			return 0;
+		return count;
+	}
+#else
+	CacheMissCounter::CacheMissCounter()
+	{
+	}
+
+
+	CacheMissCounter::~CacheMissCounter()
+	{
+	}
+
+
+	uint64_t CacheMissCounter::read() const
+	{
+		return 0;
+	}
+#endif
+
+
+	bool CacheMissCounter::isAvailable() const
+	{
+		return descriptor >= 0;
+	}
+
+
+	struct Options
+	{
+		char const* outputPath = "benchmark.csv";
+		char const* baselinePath = nullptr;
+		char const* filter = nullptr;
+		// percent a median may grow over the baseline before it counts as a regression
+		double threshold = 5.0;
+		// scale of every scenario's sample count
+		double sampleScale = 1.0;
+		// stop sampling a scenario after this long, but take at least minSamples
+		double maxSecondsPerScenario = 2.0;
+	};
+
+	constexpr int minSamples = 5;
+
+	Options options;
+	CacheMissCounter cacheMissCounter;
+	// stable addresses, scenarios keep pointers to the results they fill
+	std::deque< Result > results;
+	bool isWarmingUp = false;
+
+
+	double percentile( std::vector< double > const& sorted, double fraction )
+	{
+		const double position = fraction * double( sorted.size() - 1 );
+		const size_t below = size_t( position );
+		const size_t above = std::min( below + 1, sorted.size() - 1 );
+		return sorted[ below ] + ( sorted[ above ] - sorted[ below ] ) * ( position - double( below ) );
+	}
+
+
+	Summary summarize( std::vector< double > samples )
+	{
+		Summary summary;
+		if ( samples.empty() )
+			return summary;
+
+		std::sort( samples.begin(), samples.end() );
+		summary.samples = int( samples.size() );
+		summary.min = samples.front();
+		summary.median = percentile( samples, 0.5 );
+		summary.p95 = percentile( samples, 0.95 );
+
+		double sum = 0.0;
+		for ( double sample : samples )
+			sum += sample;
+		summary.mean = sum / double( samples.size() );
+
+		double squares = 0.0;
+		for ( double sample : samples )
+			squares += ( sample - summary.mean ) * ( sample - summary.mean );
+		summary.stdDev = samples.size() > 1 ? std::sqrt( squares / double( samples.size() - 1 ) ) : 0.0;
+		return summary;
+	}
+
+
+	Summary summarize( Result const& result )
+	{
+		Summary summary = summarize( result.samples );
+		if ( result.countedSamples > 0 )
+			summary.cacheMisses = result.cacheMisses / double( result.countedSamples );
+		return summary;
+	}
+
+
+	bool isSelected( std::string const& name )
+	{
+		return !options.filter || name.find( options.filter ) != std::string::npos;
+	}
+
+
+	// nullptr when the filter leaves the scenario out
+	Result* select( std::string const& name )
+	{
+		if ( !isSelected( name ) )
+			return nullptr;
+		results.push_back( { name, {} } );
+		return &results.back();
+	}
+
+
+	int sampleCount( int samples )
+	{
+		return std::max( minSamples, int( samples * options.sampleScale ) );
+	}
+
+
+	// one timed run of sample(), added to the result when there is one
+	void timeSample( Result* result, std::function< void() > const& sample )
+	{
+		const uint64_t misses = cacheMissCounter.read();
+		const double start = Clock::now();
+		sample();
+		const double elapsed = Clock::now() - start;
+		if ( !result )
+			return;
+
+		result->samples.push_back( elapsed * 1e6 );
+		if ( cacheMissCounter.isAvailable() )
+		{
+			result->cacheMisses += double( cacheMissCounter.read() - misses );
+			result->countedSamples++;
+		}
+	}
+
+
+	// runs one untimed warm-up, then times sample() until enough samples or the time is up;
+	// without a result the samples still run for the scenarios timed inside them
+	void measure( Result* result, int samples, std::function< void() > const& sample )
+	{
+		isWarmingUp = true;
+		sample();
+		isWarmingUp = false;
+
+		const int count = sampleCount( samples );
+		const double deadline = Clock::now() + options.maxSecondsPerScenario;
+		for ( int i = 0; i < count && ( i < minSamples || Clock::now() < deadline ); i++ )
+			timeSample( result, sample );
+	}
+
+
+	//-------------------------------------------------------
+	//	physics: the game's own table, driven shot by shot
+	//-------------------------------------------------------
+
+	// charges for the given number of steps and releases towards the target
+	void shoot( float targetX, float targetY, int chargeSteps )
+	{
+		Game::mouseButtonPressed( targetX, targetY );
+		for ( int i = 0; i < chargeSteps; i++ )
+			Game::update( stepTime );
+		Game::mouseButtonReleased( targetX, targetY );
+	}
+
+
+	// steps until every ball stopped, each step's time goes to stepTimes when given
+	int runToRest( Result* stepTimes )
+	{
+		int steps = 0;
+		while ( !Game::isQuiescent() && steps < maxStepsPerShot )
+		{
+			const double start = Clock::now();
+			Game::update( stepTime );
+			if ( stepTimes && !isWarmingUp )
+				stepTimes->samples.push_back( ( Clock::now() - start ) * 1e6 );
+			steps++;
+		}
+		return steps;
+	}
+
+
+	// seeded aim and power, from wherever the last shot left the balls
+	void randomShot( std::mt19937& random, Result* steps )
+	{
+		std::uniform_real_distribution< float > aim( 0.f, 6.2831853f );
+		std::uniform_int_distribution< int > charge( 3, int( std::ceil( 1.f / stepTime ) ) );
+
+		const float angle = aim( random );
+		// the cue ball's position is not exposed, any point far enough away gives the direction
+		shoot( 100.f * std::cos( angle ), 100.f * std::sin( angle ), charge( random ) );
+		runToRest( steps );
+	}
+
+
+	// every sample is a fresh rack of the table the setup picks, so they all replay the same shot
+	void benchmarkBreak( std::string const& table, int samples, std::function< void() > const& setUp )
+	{
+		Result* shots = select( "break_" + table + "_to_rest" );
+		Result* steps = select( "physics_step_break_" + table );
+		if ( !shots && !steps )
+			return;
+
+		const int fullCharge = int( std::ceil( 1.f / stepTime ) );
+		setUp();
+		measure( shots, samples, [ & ]
+		{
+			Game::init();
+			// straight at the head ball of the rack
+			shoot( 0.2f * tableWidth, 0.f, fullCharge );
+			runToRest( steps );
+			Game::deinit();
+		} );
+		Game::setVariant( Game::Variant::standard );
+	}
+
+
+	// one game played on: seeded aim and power, each shot from where the last one left the balls
+	void benchmarkRandomShots()
+	{
+		Result* shots = select( "shot_7_to_rest" );
+		Result* steps = select( "physics_step_random_7" );
+		if ( !shots && !steps )
+			return;
+
+		std::mt19937 random( 41 );
+		Game::init();
+		measure( shots, 200, [ & ] { randomShot( random, steps ); } );
+		Game::deinit();
+	}
+
+
+	// the huge table as a long game leaves it, the ids no longer following the positions:
+	// its rack with the places dealt out at random; the sorted storage pays for its sort
+	// at the start of every shot; the two take turns on each shot, so a machine that
+	// speeds up or slows down during the run does it to both
+	void benchmarkBallSorting()
+	{
+		Result* sortedShots = select( "shot_huge_sorted_to_rest" );
+		Result* unsortedShots = select( "shot_huge_unsorted_to_rest" );
+		if ( !sortedShots && !unsortedShots )
+			return;
+
+		Game::ShotSimulator sorted( Game::Variant::huge );
+		Game::ShotSimulator unsorted( Game::Variant::huge );
+		unsorted.setBallSorting( false );
+
+		std::mt19937 random( 44 );
+		Game::TableState table = sorted.rack();
+		// the cue ball keeps its spot
+		std::shuffle( table.begin() + 1, table.end(), random );
+
+		std::uniform_real_distribution< float > aim( 0.f, 6.2831853f );
+		std::uniform_real_distribution< float > power( 0.2f, 1.f );
+		auto nextShot = [ & ]
+		{
+			const float angle = aim( random );
+			return Game::Shot{ std::cos( angle ), std::sin( angle ), power( random ) };
+		};
+
+		const Game::Shot warmUp = nextShot();
+		sorted.simulate( table, warmUp );
+		unsorted.simulate( table, warmUp );
+
+		const int count = sampleCount( 20 );
+		const double deadline = Clock::now() + 2.0 * options.maxSecondsPerScenario;
+		for ( int i = 0; i < count && ( i < minSamples || Clock::now() < deadline ); i++ )
+		{
+			const Game::Shot shot = nextShot();
+			timeSample( sortedShots, [ & ] { sorted.simulate( table, shot ); } );
+			timeSample( unsortedShots, [ & ] { unsorted.simulate( table, shot ); } );
+		}
+	}
+
+
+	// shots off screen from the rack, simulated every time and through the cache: the
+	// queries are the aim preview's, one a frame for the shot under the mouse, which
+	// wanders a pixel at a time over a 1280 pixel wide view, or rests; a pixel turns the
+	// cue by more than the key's angle step, so only a pixel visited again hits
+	void benchmarkShotCache()
+	{
+		Result* simulations = select( "shot_simulate_7" );
+		Result* lookups = select( "shot_cache_7" );
+		if ( !simulations && !lookups )
+			return;
+
+		Game::ShotSimulator simulator;
+		ShotCache cache;
+		constexpr float pixel = Scene::View::width / 1280.f;
+		// mouse this many pixels from the cue ball, a new shot lined up every so many frames
+		constexpr float aimDistance = 200.f;
+		constexpr int framesPerShot = 500;
+
+		std::mt19937 random( 48 );
+		std::uniform_real_distribution< float > aim( -0.3f, 0.3f );
+		std::uniform_real_distribution< float > power( 0.2f, 1.f );
+		std::uniform_int_distribution< int > move( -1, 1 );
+		int mouseX = 0;
+		int mouseY = 0;
+		float shotPower = 0.f;
+		int frame = 0;
+		auto nextShot = [ & ]
+		{
+			if ( frame++ % framesPerShot == 0 )
+			{
+				const float angle = aim( random );
+				mouseX = int( aimDistance * std::cos( angle ) );
+				mouseY = int( aimDistance * std::sin( angle ) );
+				shotPower = power( random );
+			}
+			mouseX += move( random );
+			mouseY += move( random );
+
+			const float length = pixel * std::sqrt( float( mouseX * mouseX + mouseY * mouseY ) );
+			return Game::Shot{ pixel * mouseX / length, pixel * mouseY / length, shotPower };
+		};
+
+		measure( simulations, 200, [ & ] { simulator.simulate( simulator.rack(), nextShot() ); } );
+		measure( lookups, 2000, [ & ] { cache.simulate( simulator, simulator.rack(), nextShot() ); } );
+
+		const ShotCache::Stats stats = cache.stats();
+		std::printf( "shot cache: %llu lookups, %.1f%% hits, %zu entries, %zu KB\n", (unsigned long long)( stats.hits + stats.misses ),
+			100.0 * stats.hitRate(), stats.entries, stats.bytes >> 10 );
+	}
+
+
+	//-------------------------------------------------------
+	//	rendering: seeded random layouts drawn on the recording backend
+	//-------------------------------------------------------
+
+	class Layout
+	{
+	public:
+		Layout( int ballCount, uint32_t seed ) :
+			random( seed )
+		{
+			std::uniform_real_distribution< float > x( -0.5f * tableWidth + ballRadius, 0.5f * tableWidth - ballRadius );
+			std::uniform_real_distribution< float > y( -0.5f * tableHeight + ballRadius, 0.5f * tableHeight - ballRadius );
+			for ( int i = 0; i < ballCount; i++ )
+			{
+				meshes.push_back( Scene::createBallMesh( ballRadius ) );
+				Scene::teleportMesh( meshes.back(), x( random ), y( random ), 0.f );
+			}
+		}
+
+		~Layout()
+		{
+			for ( Scene::Mesh* mesh : meshes )
+				Scene::destroyMesh( mesh );
+		}
+
+		// a step moving every ball a little, as a break in full swing would
+		void step()
+		{
+			std::uniform_real_distribution< float > offset( -0.05f, 0.05f );
+			Scene::beginStep();
+			for ( Scene::Mesh* mesh : meshes )
+				Scene::placeMesh( mesh, offset( random ), offset( random ), 0.f );
+		}
+
+	private:
+		std::mt19937 random;
+		std::vector< Scene::Mesh* > meshes;
+	};
+
+
+	void benchmarkLayout( int ballCount, int samples, Gl::RecordingBackend& backend )
+	{
+		const std::string suffix = "_" + std::to_string( ballCount );
+		Result* publishes = select( "scene_publish" + suffix );
+		Result* draws = select( "scene_draw" + suffix );
+		if ( !publishes && !draws )
+			return;
+
+		Layout layout( ballCount, uint32_t( ballCount ) );
+		if ( publishes )
+			measure( publishes, samples, [ & ]
+			{
+				layout.step();
+				Scene::publishFrame( 0.5f );
+			} );
+
+		layout.step();
+		Scene::publishFrame( 0.5f );
+		if ( draws )
+			measure( draws, samples, [ & ]
+			{
+				backend.commands.clear();
+				Scene::draw();
+			} );
+	}
+
+
+	// the whole engine iteration of a running game: step, publish and draw
+	void benchmarkFrame( Gl::RecordingBackend& backend )
+	{
+		Result* frames = select( "frame_7" );
+		if ( !frames )
+			return;
+
+		const int fullCharge = int( std::ceil( 1.f / stepTime ) );
+		Game::init();
+		shoot( 0.2f * tableWidth, 0.f, fullCharge );
+		// re-racking lands in the odd sample, the median doesn't see it
+		measure( frames, 500, [ & ]
+		{
+			if ( Game::isQuiescent() )
+			{
+				Game::deinit();
+				Game::init();
+				shoot( 0.2f * tableWidth, 0.f, fullCharge );
+			}
+			Scene::beginStep();
+			Game::update( stepTime );
+			Scene::publishFrame( 0.5f );
+			backend.commands.clear();
+			Scene::draw();
+		} );
+		Game::deinit();
+	}
+
+
+	//-------------------------------------------------------
+	//	software rasterizer: a frame of the running game
+	//-------------------------------------------------------
+
+	// the table a few steps into the break, balls spread and moving
+	Scene::Frame breakFrame()
+	{
+		constexpr int steps = 10;
+
+		Game::init();
+		shoot( 0.2f * tableWidth, 0.f, int( std::ceil( 1.f / stepTime ) ) );
+		for ( int i = 0; i < steps; i++ )
+		{
+			Scene::beginStep();
+			Game::update( stepTime );
+		}
+		Scene::publishFrame( 0.5f );
+		const Scene::Frame frame = Scene::acquireFrame();
+		Game::deinit();
+		return frame;
+	}
+
+
+	// the serial renderer with its static layer cached, as the headless capture draws;
+	// checked against a render that rasterizes the static layer anew
+	void benchmarkRaster( Scene::Frame const& frame )
+	{
+		Result* frames = select( "raster_frame" );
+		if ( !frames )
+			return;
+
+		Raster::Framebuffer framebuffer( frameWidth, frameHeight );
+		Raster::StaticLayer staticLayer;
+		measure( frames, 200, [ & ]
+		{
+			Raster::render( frame, framebuffer, staticLayer );
+		} );
+
+		Raster::Framebuffer uncached( frameWidth, frameHeight );
+		Raster::render( frame, uncached );
+		if ( uncached.pixels != framebuffer.pixels )
+			std::printf( "raster_frame: static layer cache MISMATCH with uncached output\n" );
+	}
+
+
+	// the tile-parallel renderer at thread counts doubling up to the hardware's,
+	// each checked against the serial output
+	void benchmarkTiledRaster( Scene::Frame const& frame )
+	{
+		Raster::Framebuffer reference( frameWidth, frameHeight );
+		Raster::render( frame, reference );
+
+		const int hardwareThreads = int( std::max( 1u, std::thread::hardware_concurrency() ) );
+		for ( int threads = 1; ; threads = std::min( threads * 2, hardwareThreads ) )
+		{
+			const std::string name = "raster_tiled_" + std::to_string( threads );
+			if ( Result* frames = select( name ) )
+			{
+				ThreadPool pool( threads );
+				Raster::TiledRenderer renderer( pool );
+				Raster::Framebuffer framebuffer( frameWidth, frameHeight );
+				measure( frames, 200, [ & ]
+				{
+					renderer.render( frame, framebuffer );
+				} );
+				if ( framebuffer.pixels != reference.pixels )
+					std::printf( "%s: MISMATCH with serial output\n", name.c_str() );
+			}
+
+			if ( threads == hardwareThreads )
+				break;
+		}
+	}
+
+
+	// creates a batch of meshes and destroys them in seeded random order
+	void benchmarkMeshChurn( int meshCount )
+	{
+		Result* churns = select( "mesh_churn_" + std::to_string( meshCount ) );
+		if ( !churns )
+			return;
+
+		std::mt19937 random( meshCount );
+		std::vector< Scene::Mesh* > meshes;
+		measure( churns, 100, [ & ]
+		{
+			for ( int i = 0; i < meshCount; i++ )
+			{
+				meshes.push_back( i % 2 ? Scene::createBallMesh( ballRadius ) : Scene::createPocketMesh( ballRadius ) );
+				Scene::placeMesh( meshes.back(), 0.f, 0.f, 0.f );
+			}
+			std::shuffle( meshes.begin(), meshes.end(), random );
+			for ( Scene::Mesh* mesh : meshes )
+				Scene::destroyMesh( mesh );
+			meshes.clear();
+		} );
+	}
+
+
+	//-------------------------------------------------------
+	//	results
+	//-------------------------------------------------------
+
+	bool writeResults( char const* path )
+	{
+		std::ofstream file( path );
+		if ( !file )
+			return false;
+
+		// the miss column stays empty where the counter is unavailable
+		file << "scenario,samples,min_us,median_us,mean_us,stddev_us,p95_us,l1d_misses\n";
+		for ( Result const& result : results )
+		{
+			const Summary summary = summarize( result );
+			file << result.name << ',' << summary.samples << ',' << summary.min << ',' << summary.median << ','
+				<< summary.mean << ',' << summary.stdDev << ',' << summary.p95 << ',';
+			if ( summary.cacheMisses >= 0.0 )
+				file << summary.cacheMisses;
+			file << '\n';
+		}
+		return bool( file );
+	}
+
+
+	// scenario name to its summary, as written by writeResults()
+	bool loadBaseline( char const* path, std::map< std::string, Summary >& baseline )
+	{
+		std::ifstream file( path );
+		std::string line;
+		if ( !file || !std::getline( file, line ) )
+			return false;
+
+		while ( std::getline( file, line ) )
+		{
+			std::istringstream row( line );
+			std::string name;
+			Summary summary;
+			char comma[ 6 ];
+			if ( std::getline( row, name, ',' ) && row >> summary.samples >> comma[ 0 ] >> summary.min >> comma[ 1 ] >> summary.median
+				>> comma[ 2 ] >> summary.mean >> comma[ 3 ] >> summary.stdDev >> comma[ 4 ] >> summary.p95 )
+				baseline[ name ] = summary;
+		}
+		return true;
+	}
+
+
+	// a median counts as regressed when it grew by more than the threshold
+	// and by more than the spread of both runs, so noise alone doesn't trip it
+	int compareWithBaseline( std::map< std::string, Summary > const& baseline )
+	{
+		int regressions = 0;
+		std::printf( "\n%-32s %12s %12s %9s\n", "scenario", "baseline us", "median us", "change" );
+		for ( Result const& result : results )
+		{
+			auto it = baseline.find( result.name );
+			if ( it == baseline.end() )
+			{
+				std::printf( "%-32s %12s\n", result.name.c_str(), "new" );
+				continue;
+			}
+
+			const Summary current = summarize( result );
+			const Summary& previous = it->second;
+			const double change = previous.median > 0.0 ? ( current.median / previous.median - 1.0 ) * 100.0 : 0.0;
+			const double noise = std::max( current.stdDev, previous.stdDev ) / std::sqrt( double( std::max( 1, current.samples ) ) );
+			const bool isRegression = change > options.threshold && current.median - previous.median > 2.0 * noise;
+			regressions += isRegression;
+			std::printf( "%-32s %12.2f %12.2f %+8.1f%%%s\n", result.name.c_str(), previous.median, current.median, change, isRegression ? "  regression" : "" );
+		}
+		return regressions;
+	}
+
+
+	bool parseOptions( int argc, char* argv[] )
+	{
+		for ( int i = 1; i < argc; i++ )
+		{
+			const bool hasValue = i + 1 < argc;
+			if ( std::strcmp( argv[ i ], "--out" ) == 0 && hasValue )
+				options.outputPath = argv[ ++i ];
+			else if ( std::strcmp( argv[ i ], "--baseline" ) == 0 && hasValue )
+				options.baselinePath = argv[ ++i ];
+			else if ( std::strcmp( argv[ i ], "--filter" ) == 0 && hasValue )
+				options.filter = argv[ ++i ];
+			else if ( std::strcmp( argv[ i ], "--threshold" ) == 0 && hasValue )
+				options.threshold = std::atof( argv[ ++i ] );
+			else if ( std::strcmp( argv[ i ], "--scale" ) == 0 && hasValue )
+				options.sampleScale = std::atof( argv[ ++i ] );
+			else if ( std::strcmp( argv[ i ], "--seconds" ) == 0 && hasValue )
+				options.maxSecondsPerScenario = std::atof( argv[ ++i ] );
+			else
+				return false;
+		}
+		return options.sampleScale > 0.0 && options.maxSecondsPerScenario > 0.0;
+	}
+}
+
+
+int main( int argc, char* argv[] )
+{
+	if ( !parseOptions( argc, argv ) )
+	{
+		std::printf( "usage: benchmark [--out results.csv] [--baseline baseline.csv] [--threshold percent]\n"
+			"                 [--filter text] [--scale samples] [--seconds per scenario]\n"
+			"a scenario regresses when its median grows by more than the threshold (5%% by default) and the noise\n"
+			"the exit code is 2 when any scenario regressed against the baseline\n" );
+		return 1;
+	}
+
+	std::map< std::string, Summary > baseline;
+	if ( options.baselinePath && !loadBaseline( options.baselinePath, baseline ) )
+	{
+		std::printf( "can't load baseline %s\n", options.baselinePath );
+		return 1;
+	}
+
+	Gl::RecordingBackend backend;
+	Gl::setBackend( &backend );
+	Scene::setViewport( frameWidth, frameHeight );
+
+	// each compiled variant, and runtime configured tables of the same and other sizes:
+	// 16 balls fill the inline storage, 64 live on the heap
+	benchmarkBreak( "7", 50, [] { Game::setVariant( Game::Variant::standard ); } );
+	benchmarkBreak( "7_runtime", 50, [] { Game::setBallCount( 7 ); } );
+	benchmarkBreak( "pool", 50, [] { Game::setVariant( Game::Variant::pool ); } );
+	benchmarkBreak( "16_runtime", 50, [] { Game::setBallCount( 16 ); } );
+	benchmarkBreak( "snooker", 50, [] { Game::setVariant( Game::Variant::snooker ); } );
+	benchmarkBreak( "carom", 50, [] { Game::setVariant( Game::Variant::carom ); } );
+	benchmarkBreak( "stress", 10, [] { Game::setVariant( Game::Variant::stress ); } );
+	benchmarkBreak( "64_runtime", 20, [] { Game::setBallCount( 64 ); } );
+	benchmarkRandomShots();
+	benchmarkBallSorting();
+	benchmarkShotCache();
+	benchmarkFrame( backend );
+	const Scene::Frame frame = breakFrame();
+	benchmarkRaster( frame );
+	benchmarkTiledRaster( frame );
+	benchmarkLayout( 100, 1000, backend );
+	benchmarkLayout( 10000, 100, backend );
+	benchmarkLayout( 100000, 20, backend );
+	benchmarkMeshChurn( 100 );
+	benchmarkMeshChurn( 1000 );
+
+	Gl::setBackend( nullptr );
+
+	std::printf( "%-32s %8s %10s %10s %10s %10s %10s %12s\n", "scenario", "samples", "min us", "median us", "mean us", "stddev us", "p95 us", "L1d misses" );
+	for ( Result const& result : results )
+	{
+		const Summary summary = summarize( result );
+		std::printf( "%-32s %8d %10.2f %10.2f %10.2f %10.2f %10.2f ", result.name.c_str(), summary.samples,
+			summary.min, summary.median, summary.mean, summary.stdDev, summary.p95 );
+		if ( summary.cacheMisses >= 0.0 )
+			std::printf( "%12.0f\n", summary.cacheMisses );
+		else
+			std::printf( "%12s\n", "n/a" );
+	}
+
+	if ( !writeResults( options.outputPath ) )
+	{
+		std::printf( "can't write %s\n", options.outputPath );
+		return 1;
+	}
+
+	const int regressions = options.baselinePath ? compareWithBaseline( baseline ) : 0;
+	return regressions > 0 ? 2 : 0;
+}
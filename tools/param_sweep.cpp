@@ -0,0 +1,581 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "../framework/clock.hpp"
+#include "../framework/game.hpp"
+#include "../framework/thread_pool.hpp"
+
+
+//-------------------------------------------------------
+//	physics calibration: every combination on a grid of
+//	friction, impulse and accurance replays a corpus of
+//	reference shots off screen, the one whose resting
+//	tables come closest to the references fits best
+//-------------------------------------------------------
+
+namespace
+{
+	struct Reference
+	{
+		Game::TableState start;
+		Game::Shot shot;
+		Game::TableState rest;
+	};
+
+
+	// how well one combination reproduces the corpus
+	struct Fit
+	{
+		double rmsError = 0.0;
+		int pocketMismatches = 0;
+	};
+
+
+	struct Options
+	{
+		char const* corpusPath = nullptr;
+		char const* checkpointPath = "sweep.checkpoint";
+		char const* outputPath = "sweep.csv";
+		Game::Variant variant = Game::Variant::standard;
+		std::vector< float > frictions = { Game::Physics().friction };
+		std::vector< float > impulses = { Game::Physics().impulse };
+		std::vector< float > accurances = { Game::Physics().accurance };
+		int threads = 0;
+		int shardIndex = 0;
+		int shardCount = 1;
+
+		// corpus generation instead of a sweep
+		char const* makeCorpusPath = nullptr;
+		int shots = 200;
+		unsigned seed = 47;
+	};
+
+	Options options;
+
+
+	//-------------------------------------------------------
+	//	parameter grid
+	//-------------------------------------------------------
+
+	// "min:max:count" spaced evenly, or a comma separated list
+	bool parseValues( char const* text, std::vector< float >& values )
+	{
+		values.clear();
+		double min = 0.0;
+		double max = 0.0;
+		int count = 0;
+		// in double, so round values like the game's own land on the same float
+		if ( std::sscanf( text, "%lf:%lf:%d", &min, &max, &count ) == 3 )
+		{
+			for ( int i = 0; i < count; i++ )
+				values.push_back( float( count > 1 ? min + ( max - min ) * i / ( count - 1 ) : min ) );
+			return count > 0;
+		}
+
+		for ( char const* item = text; *item; )
+		{
+			char* end = nullptr;
+			values.push_back( std::strtof( item, &end ) );
+			if ( end == item || ( *end && *end != ',' ) )
+				return false;
+			item = *end ? end + 1 : end;
+		}
+		return !values.empty();
+	}
+
+
+	int gridSize()
+	{
+		return int( options.frictions.size() * options.impulses.size() * options.accurances.size() );
+	}
+
+
+	// friction varies slowest, accurance fastest
+	Game::Physics gridPoint( int index )
+	{
+		const int accurances = int( options.accurances.size() );
+		const int impulses = int( options.impulses.size() );
+
+		Game::Physics physics;
+		physics.accurance = options.accurances[ index % accurances ];
+		physics.impulse = options.impulses[ index / accurances % impulses ];
+		physics.friction = options.frictions[ index / accurances / impulses ];
+		return physics;
+	}
+
+
+	//-------------------------------------------------------
+	//	corpus: one shot per line, the ball count, the shot,
+	//	then x, y and pocketed of every ball at the start and at rest
+	//-------------------------------------------------------
+
+	void writeState( std::FILE* file, Game::TableState const& state )
+	{
+		for ( Game::Ball const& ball : state )
+			std::fprintf( file, " %.9g %.9g %d", ball.x, ball.y, ball.isPocketed ? 1 : 0 );
+	}
+
+
+	bool readState( char const*& text, int ballCount, Game::TableState& state )
+	{
+		state.resize( size_t( ballCount ) );
+		for ( Game::Ball& ball : state )
+		{
+			int isPocketed = 0;
+			int length = 0;
+			if ( std::sscanf( text, "%f %f %d%n", &ball.x, &ball.y, &isPocketed, &length ) != 3 )
+				return false;
+			ball.isPocketed = isPocketed != 0;
+			text += length;
+		}
+		return true;
+	}
+
+
+	bool loadCorpus( char const* path, std::vector< Reference >& corpus )
+	{
+		std::FILE* file = std::fopen( path, "r" );
+		if ( !file )
+			return false;
+
+		std::vector< char > line( 1 << 20 );
+		bool isValid = true;
+		while ( isValid && std::fgets( line.data(), int( line.size() ), file ) )
+		{
+			if ( line[ 0 ] == '#' || line[ 0 ] == '\n' )
+				continue;
+
+			Reference reference;
+			int ballCount = 0;
+			int length = 0;
+			char const* text = line.data();
+			isValid = std::sscanf( text, "%d %f %f %f%n", &ballCount, &reference.shot.directionX, &reference.shot.directionY, &reference.shot.power, &length ) == 4 && ballCount > 0;
+			text += length;
+			isValid = isValid && readState( text, ballCount, reference.start ) && readState( text, ballCount, reference.rest );
+			corpus.push_back( reference );
+		}
+		std::fclose( file );
+		return isValid && !corpus.empty();
+	}
+
+
+	// a game played on with the given physics: seeded aim and power, each shot from where
+	// the last one left the balls, a new rack after a scratch or once the table is cleared
+	bool makeCorpus( char const* path, Game::Physics const& physics )
+	{
+		std::FILE* file = std::fopen( path, "w" );
+		if ( !file )
+			return false;
+
+		std::mt19937 random( options.seed );
+		std::uniform_real_distribution< float > aim( 0.f, 6.2831853f );
+		std::uniform_real_distribution< float > power( 0.2f, 1.f );
+
+		Game::ShotSimulator simulator( options.variant );
+		simulator.setPhysics( physics );
+		std::fprintf( file, "# friction %.9g impulse %.9g accurance %.9g, seed %u\n", physics.friction, physics.impulse, physics.accurance, options.seed );
+
+		Game::TableState table = simulator.rack();
+		for ( int shot = 0; shot < options.shots; shot++ )
+		{
+			const float angle = aim( random );
+			Game::Shot cue;
+			cue.directionX = std::cos( angle );
+			cue.directionY = std::sin( angle );
+			cue.power = power( random );
+			const Game::ShotOutcome outcome = simulator.simulate( table, cue );
+
+			std::fprintf( file, "%d %.9g %.9g %.9g", int( table.size() ), cue.directionX, cue.directionY, cue.power );
+			writeState( file, table );
+			writeState( file, outcome.rest );
+			std::fprintf( file, "\n" );
+
+			const bool isCleared = std::count_if( outcome.rest.begin(), outcome.rest.end(), []( Game::Ball const& ball ) { return !ball.isPocketed; } ) <= 1;
+			table = outcome.isScratch || isCleared ? simulator.rack() : outcome.rest;
+		}
+		return std::fclose( file ) == 0;
+	}
+
+
+	Fit evaluate( Game::Physics const& physics, std::vector< Reference > const& corpus )
+	{
+		Game::ShotSimulator simulator( options.variant );
+		simulator.setPhysics( physics );
+		// a ball on the wrong side of a pocket counts as far off as the table's diagonal
+		const double mismatchPenalty = double( simulator.tableWidth() ) * simulator.tableWidth() + double( simulator.tableHeight() ) * simulator.tableHeight();
+
+		Fit fit;
+		double squaredErrors = 0.0;
+		size_t balls = 0;
+		for ( Reference const& reference : corpus )
+		{
+			const Game::ShotOutcome outcome = simulator.simulate( reference.start, reference.shot );
+			for ( size_t id = 0; id < reference.rest.size(); id++ )
+			{
+				Game::Ball const& expected = reference.rest[ id ];
+				Game::Ball const& actual = outcome.rest[ id ];
+				if ( expected.isPocketed != actual.isPocketed )
+				{
+					squaredErrors += mismatchPenalty;
+					fit.pocketMismatches++;
+				}
+				else if ( !expected.isPocketed )
+				{
+					const double dx = double( actual.x ) - double( expected.x );
+					const double dy = double( actual.y ) - double( expected.y );
+					squaredErrors += dx * dx + dy * dy;
+				}
+			}
+			balls += reference.rest.size();
+		}
+		fit.rmsError = std::sqrt( squaredErrors / double( std::max< size_t >( balls, 1 ) ) );
+		return fit;
+	}
+
+
+	//-------------------------------------------------------
+	//	checkpoint: a line per finished combination, appended as soon
+	//	as it is done; shards may share the file, each line is one write
+	//-------------------------------------------------------
+
+	// ties the checkpoint to its corpus, FNV-1a over the file
+	uint64_t hashFile( char const* path )
+	{
+		uint64_t hash = 14695981039346656037ull;
+		std::FILE* file = std::fopen( path, "rb" );
+		if ( !file )
+			return hash;
+		for ( int c = std::fgetc( file ); c != EOF; c = std::fgetc( file ) )
+			hash = ( hash ^ uint64_t( c ) ) * 1099511628211ull;
+		std::fclose( file );
+		return hash;
+	}
+
+
+	// lines of other grids are skipped and counted, as is a last line cut short by a
+	// killed process; false when the checkpoint belongs to another corpus or variant
+	bool loadCheckpoint( char const* path, std::string const& header, std::vector< Fit >& fits, std::vector< bool >& isDone, int& skipped )
+	{
+		std::FILE* file = std::fopen( path, "r" );
+		if ( !file )
+			return true;
+
+		char line[ 256 ];
+		bool isValid = true;
+		skipped = 0;
+		while ( isValid && std::fgets( line, sizeof( line ), file ) )
+		{
+			if ( line[ 0 ] == '#' )
+			{
+				isValid = header == line;
+				continue;
+			}
+
+			int index = 0;
+			Game::Physics physics;
+			Fit fit;
+			const bool isComplete = std::strchr( line, '\n' ) != nullptr;
+			const bool isParsed = std::sscanf( line, "%d %f %f %f %lf %d", &index, &physics.friction, &physics.impulse, &physics.accurance, &fit.rmsError, &fit.pocketMismatches ) == 6;
+			if ( !isComplete || !isParsed || index < 0 || index >= gridSize() )
+			{
+				skipped++;
+				continue;
+			}
+
+			const Game::Physics expected = gridPoint( index );
+			if ( physics.friction != expected.friction || physics.impulse != expected.impulse || physics.accurance != expected.accurance )
+			{
+				skipped++;
+				continue;
+			}
+			fits[ index ] = fit;
+			isDone[ index ] = true;
+		}
+		std::fclose( file );
+		return isValid;
+	}
+
+
+	//-------------------------------------------------------
+	//	report
+	//-------------------------------------------------------
+
+	int findBest( std::vector< Fit > const& fits, std::vector< bool > const& isDone )
+	{
+		int best = -1;
+		for ( int i = 0; i < gridSize(); i++ )
+			if ( isDone[ i ] && ( best < 0 || fits[ i ].rmsError < fits[ best ].rmsError ) )
+				best = i;
+		return best;
+	}
+
+
+	// the combination that differs from the given one in a single parameter
+	int neighbour( int index, int parameter, int value )
+	{
+		const int accurances = int( options.accurances.size() );
+		const int impulses = int( options.impulses.size() );
+		int coordinates[ 3 ] = { index / accurances / impulses, index / accurances % impulses, index % accurances };
+		coordinates[ parameter ] = value;
+		return ( coordinates[ 0 ] * impulses + coordinates[ 1 ] ) * accurances + coordinates[ 2 ];
+	}
+
+
+	// the error along each parameter through the best fit, then friction against impulse
+	void printSurface( std::vector< Fit > const& fits, std::vector< bool > const& isDone, int best )
+	{
+		char const* names[ 3 ] = { "friction", "impulse", "accurance" };
+		std::vector< float > const* values[ 3 ] = { &options.frictions, &options.impulses, &options.accurances };
+
+		for ( int parameter = 0; parameter < 3; parameter++ )
+		{
+			if ( values[ parameter ]->size() < 2 )
+				continue;
+			std::printf( "\n%-10s %12s %10s\n", names[ parameter ], "rms error", "mismatches" );
+			for ( int value = 0; value < int( values[ parameter ]->size() ); value++ )
+			{
+				const int index = neighbour( best, parameter, value );
+				if ( isDone[ index ] )
+					std::printf( "%-10.5g %12.5f %10d%s\n", ( *values[ parameter ] )[ value ], fits[ index ].rmsError, fits[ index ].pocketMismatches, index == best ? "  best" : "" );
+				else
+					std::printf( "%-10.5g %12s\n", ( *values[ parameter ] )[ value ], "pending" );
+			}
+		}
+
+		if ( options.frictions.size() < 2 || options.impulses.size() < 2 )
+			return;
+		std::printf( "\nrms error, friction across, impulse down\n%10s", "" );
+		for ( float friction : options.frictions )
+			std::printf( " %9.4g", friction );
+		std::printf( "\n" );
+		for ( int impulse = 0; impulse < int( options.impulses.size() ); impulse++ )
+		{
+			std::printf( "%10.4g", options.impulses[ impulse ] );
+			for ( int friction = 0; friction < int( options.frictions.size() ); friction++ )
+			{
+				const int index = neighbour( neighbour( best, 0, friction ), 1, impulse );
+				if ( isDone[ index ] )
+					std::printf( " %9.4f", fits[ index ].rmsError );
+				else
+					std::printf( " %9s", "-" );
+			}
+			std::printf( "\n" );
+		}
+	}
+
+
+	bool writeSurface( char const* path, std::vector< Fit > const& fits, std::vector< bool > const& isDone )
+	{
+		std::FILE* file = std::fopen( path, "w" );
+		if ( !file )
+			return false;
+
+		std::fprintf( file, "friction,impulse,accurance,rms_error,pocket_mismatches\n" );
+		for ( int i = 0; i < gridSize(); i++ )
+		{
+			if ( !isDone[ i ] )
+				continue;
+			const Game::Physics physics = gridPoint( i );
+			std::fprintf( file, "%.9g,%.9g,%.9g,%.9g,%d\n", physics.friction, physics.impulse, physics.accurance, fits[ i ].rmsError, fits[ i ].pocketMismatches );
+		}
+		return std::fclose( file ) == 0;
+	}
+
+
+	// in Game::Variant order
+	char const* const variantNames[] = { "standard", "pool", "snooker", "carom", "stress", "huge" };
+
+
+	bool parseVariant( char const* name )
+	{
+		for ( int i = 0; i < 6; i++ )
+			if ( std::strcmp( name, variantNames[ i ] ) == 0 )
+			{
+				options.variant = Game::Variant( i );
+				return true;
+			}
+		return false;
+	}
+
+
+	bool parseOptions( int argc, char* argv[] )
+	{
+		for ( int i = 1; i < argc; i++ )
+		{
+			const bool hasValue = i + 1 < argc;
+			if ( std::strcmp( argv[ i ], "--friction" ) == 0 && hasValue )
+			{
+				if ( !parseValues( argv[ ++i ], options.frictions ) )
+					return false;
+			}
+			else if ( std::strcmp( argv[ i ], "--impulse" ) == 0 && hasValue )
+			{
+				if ( !parseValues( argv[ ++i ], options.impulses ) )
+					return false;
+			}
+			else if ( std::strcmp( argv[ i ], "--accurance" ) == 0 && hasValue )
+			{
+				if ( !parseValues( argv[ ++i ], options.accurances ) )
+					return false;
+			}
+			else if ( std::strcmp( argv[ i ], "--variant" ) == 0 && hasValue )
+			{
+				if ( !parseVariant( argv[ ++i ] ) )
+					return false;
+			}
+			else if ( std::strcmp( argv[ i ], "--checkpoint" ) == 0 && hasValue )
+				options.checkpointPath = argv[ ++i ];
+			else if ( std::strcmp( argv[ i ], "--out" ) == 0 && hasValue )
+				options.outputPath = argv[ ++i ];
+			else if ( std::strcmp( argv[ i ], "--threads" ) == 0 && hasValue )
+				options.threads = std::atoi( argv[ ++i ] );
+			else if ( std::strcmp( argv[ i ], "--shard" ) == 0 && hasValue )
+			{
+				if ( std::sscanf( argv[ ++i ], "%d/%d", &options.shardIndex, &options.shardCount ) != 2 )
+					return false;
+			}
+			else if ( std::strcmp( argv[ i ], "--make-corpus" ) == 0 && hasValue )
+				options.makeCorpusPath = argv[ ++i ];
+			else if ( std::strcmp( argv[ i ], "--shots" ) == 0 && hasValue )
+				options.shots = std::atoi( argv[ ++i ] );
+			else if ( std::strcmp( argv[ i ], "--seed" ) == 0 && hasValue )
+				options.seed = unsigned( std::strtoul( argv[ ++i ], nullptr, 10 ) );
+			else if ( argv[ i ][ 0 ] != '-' && !options.corpusPath )
+				options.corpusPath = argv[ i ];
+			else
+				return false;
+		}
+		return ( options.corpusPath || options.makeCorpusPath ) && options.shots > 0 &&
+			options.shardCount > 0 && options.shardIndex >= 0 && options.shardIndex < options.shardCount;
+	}
+}
+
+
+int main( int argc, char* argv[] )
+{
+	if ( !parseOptions( argc, argv ) )
+	{
+		std::printf( "usage: param_sweep corpus.txt [--friction values] [--impulse values] [--accurance values]\n"
+			"                   [--variant name] [--checkpoint file] [--out surface.csv] [--threads n] [--shard k/n]\n"
+			"       param_sweep --make-corpus corpus.txt [--shots n] [--seed n] [--friction value] [--impulse value] [--accurance value]\n"
+			"values are min:max:count or a comma separated list, the game's own when left out\n"
+			"an interrupted sweep resumes from its checkpoint; shards k of n, run as separate processes,\n"
+			"take every n-th combination and may share one checkpoint\n" );
+		return 1;
+	}
+
+	if ( options.makeCorpusPath )
+	{
+		Game::Physics physics;
+		physics.friction = options.frictions.front();
+		physics.impulse = options.impulses.front();
+		physics.accurance = options.accurances.front();
+		if ( !makeCorpus( options.makeCorpusPath, physics ) )
+		{
+			std::printf( "can't write %s\n", options.makeCorpusPath );
+			return 1;
+		}
+		std::printf( "%d shots written to %s\n", options.shots, options.makeCorpusPath );
+		return 0;
+	}
+
+	std::vector< Reference > corpus;
+	if ( !loadCorpus( options.corpusPath, corpus ) )
+	{
+		std::printf( "can't load corpus %s\n", options.corpusPath );
+		return 1;
+	}
+
+	// a corpus of another table would be compared ball by ball against the wrong rack
+	char const* variantName = variantNames[ int( options.variant ) ];
+	const size_t rackSize = Game::ShotSimulator( options.variant ).rack().size();
+	for ( size_t i = 0; i < corpus.size(); i++ )
+		if ( corpus[ i ].start.size() != rackSize )
+		{
+			std::printf( "corpus %s: shot %d has %d balls where the %s table has %d, was it made for another --variant?\n",
+				options.corpusPath, int( i + 1 ), int( corpus[ i ].start.size() ), variantName, int( rackSize ) );
+			return 1;
+		}
+
+	char header[ 96 ];
+	std::snprintf( header, sizeof( header ), "# corpus %016llx %d, variant %s\n", ( unsigned long long )hashFile( options.corpusPath ), int( corpus.size() ), variantName );
+
+	std::vector< Fit > fits( gridSize() );
+	std::vector< bool > isDone( gridSize(), false );
+	int skipped = 0;
+	if ( !loadCheckpoint( options.checkpointPath, header, fits, isDone, skipped ) )
+	{
+		std::printf( "checkpoint %s belongs to another corpus or variant\n", options.checkpointPath );
+		return 1;
+	}
+	if ( skipped > 0 )
+		std::printf( "checkpoint: %d lines of another grid or cut short, ignored\n", skipped );
+
+	std::vector< int > pending;
+	for ( int i = options.shardIndex; i < gridSize(); i += options.shardCount )
+		if ( !isDone[ i ] )
+			pending.push_back( i );
+
+	std::FILE* checkpoint = std::fopen( options.checkpointPath, "a" );
+	if ( !checkpoint )
+	{
+		std::printf( "can't write checkpoint %s\n", options.checkpointPath );
+		return 1;
+	}
+	std::fseek( checkpoint, 0, SEEK_END );
+	if ( std::ftell( checkpoint ) == 0 )
+	{
+		std::fputs( header, checkpoint );
+		std::fflush( checkpoint );
+	}
+
+	ThreadPool pool( options.threads );
+	std::mutex mutex;
+	const double start = Clock::now();
+	pool.parallelFor( int( pending.size() ), [ & ]( int task )
+	{
+		const int index = pending[ task ];
+		const Game::Physics physics = gridPoint( index );
+		const Fit fit = evaluate( physics, corpus );
+
+		char line[ 128 ];
+		std::snprintf( line, sizeof( line ), "%d %.9g %.9g %.9g %.9g %d\n", index, physics.friction, physics.impulse, physics.accurance, fit.rmsError, fit.pocketMismatches );
+
+		std::lock_guard< std::mutex > lock( mutex );
+		fits[ index ] = fit;
+		isDone[ index ] = true;
+		std::fputs( line, checkpoint );
+		std::fflush( checkpoint );
+	} );
+	std::fclose( checkpoint );
+
+	// combinations finished by other shards count too
+	std::fill( isDone.begin(), isDone.end(), false );
+	loadCheckpoint( options.checkpointPath, header, fits, isDone, skipped );
+	const int done = int( std::count( isDone.begin(), isDone.end(), true ) );
+	std::printf( "%d of %d combinations done, %d here in %.2f s with %d threads, %d reference shots each\n",
+		done, gridSize(), int( pending.size() ), Clock::now() - start, pool.size(), int( corpus.size() ) );
+
+	const int best = findBest( fits, isDone );
+	if ( best < 0 )
+		return 0;
+
+	const Game::Physics physics = gridPoint( best );
+	std::printf( "%s fit: friction %.5g, impulse %.5g, accurance %.5g, rms error %.5f, %d pocket mismatches\n",
+		done == gridSize() ? "best" : "best so far", physics.friction, physics.impulse, physics.accurance, fits[ best ].rmsError, fits[ best ].pocketMismatches );
+	printSurface( fits, isDone, best );
+
+	if ( !writeSurface( options.outputPath, fits, isDone ) )
+	{
+		std::printf( "can't write %s\n", options.outputPath );
+		return 1;
+	}
+	return 0;
+}
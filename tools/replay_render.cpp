@@ -0,0 +1,267 @@
+#include <algorithm>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../framework/clock.hpp"
+#include "../framework/grid.hpp"
+#include "../framework/raster.hpp"
+#include "../framework/replay.hpp"
+
+
+//-------------------------------------------------------
+//	offline replay renderer: frames are rendered in parallel
+//	and streamed in order through a bounded reorder buffer
+//-------------------------------------------------------
+
+namespace
+{
+	enum class Format
+	{
+		y4m,
+		rawRGBA
+	};
+
+
+	// one encoded frame waiting for its turn to be written
+	struct Slot
+	{
+		std::vector< char > data;
+		int frame = -1;
+	};
+
+
+	class ReorderBuffer
+	{
+	public:
+		explicit ReorderBuffer( int capacity ) :
+			slots( capacity )
+		{
+		}
+
+		// worker side: next frame index to render, -1 when done;
+		// blocks while the writer is a full buffer behind
+		int takeFrame( int frameCount )
+		{
+			std::unique_lock< std::mutex > lock( mutex );
+			slotFreed.wait( lock, [ & ] { return nextFrame - written < int( slots.size() ) || nextFrame >= frameCount; } );
+			return nextFrame < frameCount ? nextFrame++ : -1;
+		}
+
+		std::vector< char >& slotData( int frame )
+		{
+			return slots[ frame % slots.size() ].data;
+		}
+
+		void markReady( int frame )
+		{
+			{
+				std::lock_guard< std::mutex > lock( mutex );
+				slots[ frame % slots.size() ].frame = frame;
+			}
+			slotReady.notify_all();
+		}
+
+		// writer side: waits for the frame that is next in order
+		std::vector< char > const& waitFrame( int frame )
+		{
+			std::unique_lock< std::mutex > lock( mutex );
+			slotReady.wait( lock, [ & ] { return slots[ frame % slots.size() ].frame == frame; } );
+			return slots[ frame % slots.size() ].data;
+		}
+
+		void release( int frame )
+		{
+			{
+				std::lock_guard< std::mutex > lock( mutex );
+				slots[ frame % slots.size() ].frame = -1;
+				written = frame + 1;
+			}
+			slotFreed.notify_all();
+		}
+
+	private:
+		std::vector< Slot > slots;
+		std::mutex mutex;
+		std::condition_variable slotReady;
+		std::condition_variable slotFreed;
+		int nextFrame = 0;
+		int written = 0;
+	};
+
+
+	// BT.601 limited range, planar 4:4:4
+	void encodeYuv( Raster::Framebuffer const& framebuffer, std::vector< char >& data )
+	{
+		const size_t planeSize = framebuffer.pixels.size();
+		data.resize( planeSize * 3 );
+
+		for ( size_t i = 0; i < planeSize; i++ )
+		{
+			const int r = int( framebuffer.pixels[ i ] & 0xff );
+			const int g = int( framebuffer.pixels[ i ] >> 8 & 0xff );
+			const int b = int( framebuffer.pixels[ i ] >> 16 & 0xff );
+			data[ i ] = char( ( ( 66 * r + 129 * g + 25 * b + 128 ) >> 8 ) + 16 );
+			data[ planeSize + i ] = char( ( ( -38 * r - 74 * g + 112 * b + 128 ) >> 8 ) + 128 );
+			data[ 2 * planeSize + i ] = char( ( ( 112 * r - 94 * g - 18 * b + 128 ) >> 8 ) + 128 );
+		}
+	}
+
+
+	void encodeRgba( Raster::Framebuffer const& framebuffer, std::vector< char >& data )
+	{
+		data.resize( framebuffer.pixels.size() * sizeof( uint32_t ) );
+		for ( size_t i = 0; i < framebuffer.pixels.size(); i++ )
+		{
+			const uint32_t pixel = framebuffer.pixels[ i ];
+			data[ i * 4 + 0 ] = char( pixel & 0xff );
+			data[ i * 4 + 1 ] = char( pixel >> 8 & 0xff );
+			data[ i * 4 + 2 ] = char( pixel >> 16 & 0xff );
+			data[ i * 4 + 3 ] = char( pixel >> 24 & 0xff );
+		}
+	}
+
+
+	bool endsWith( std::string const& text, char const* suffix )
+	{
+		const size_t length = std::strlen( suffix );
+		return text.size() >= length && text.compare( text.size() - length, length, suffix ) == 0;
+	}
+
+
+	std::vector< std::string > splitPaths( std::string const& text )
+	{
+		std::vector< std::string > paths;
+		size_t begin = 0;
+		for ( size_t end = text.find( ',' ); end != std::string::npos; end = text.find( ',', begin ) )
+		{
+			paths.push_back( text.substr( begin, end - begin ) );
+			begin = end + 1;
+		}
+		paths.push_back( text.substr( begin ) );
+		return paths;
+	}
+}
+
+
+int main( int argc, char* argv[] )
+{
+	if ( argc < 3 )
+	{
+		std::printf( "usage: replay_render <input.replay[,input.replay...]> <output.y4m | output.rgba> [threads] [width height]\n"
+			"several inputs are shown side by side in a grid\n" );
+		return 1;
+	}
+
+	std::vector< Replay::Sequence > sequences;
+	for ( std::string const& path : splitPaths( argv[ 1 ] ) )
+	{
+		sequences.emplace_back();
+		if ( !Replay::load( path.c_str(), sequences.back() ) )
+		{
+			std::printf( "can't load replay %s\n", path.c_str() );
+			return 1;
+		}
+	}
+	Replay::Sequence const& sequence = sequences.front();
+	// the video has one rate, a grid of replays recorded at different ones would show some too fast or too slow
+	for ( size_t i = 1; i < sequences.size(); i++ )
+		if ( sequences[ i ].framesPerSecond != sequence.framesPerSecond )
+		{
+			std::printf( "%s is recorded at %d fps, %s at %d fps; a grid takes replays of one rate\n", sequences[ i ].path.c_str(),
+				sequences[ i ].framesPerSecond, sequence.path.c_str(), sequence.framesPerSecond );
+			return 1;
+		}
+
+	const std::string outputPath = argv[ 2 ];
+	const Format format = endsWith( outputPath, ".y4m" ) ? Format::y4m : Format::rawRGBA;
+	int threadCount = argc > 3 ? std::atoi( argv[ 3 ] ) : 0;
+	if ( threadCount <= 0 )
+		threadCount = int( std::max( 1u, std::thread::hardware_concurrency() ) );
+	const int width = argc > 5 ? std::atoi( argv[ 4 ] ) : 1280;
+	const int height = argc > 5 ? std::atoi( argv[ 5 ] ) : 720;
+	// frames go out at the rate all inputs were recorded at by the time they were published at,
+	// so idle stretches hold a frame as long as they lasted; shorter replays hold their last frame
+	const double framePeriod = sequence.framesPerSecond > 0 ? 1.0 / sequence.framesPerSecond : 0.0;
+	int frameCount = 0;
+	for ( Replay::Sequence const& replay : sequences )
+		if ( !replay.times.empty() )
+			frameCount = std::max( frameCount, framePeriod > 0.0 ? int( replay.duration() / framePeriod ) + 1 : int( replay.times.size() ) );
+	const Grid::Layout layout( int( sequences.size() ) );
+	const Scene::Camera camera = layout.overview();
+
+	std::ofstream output( outputPath, std::ios::binary );
+	if ( !output )
+	{
+		std::printf( "can't create %s\n", outputPath.c_str() );
+		return 1;
+	}
+	if ( format == Format::y4m )
+		output << "YUV4MPEG2 W" << width << " H" << height << " F" << sequence.framesPerSecond << ":1 Ip A1:1 C444\n";
+
+	// a couple of frames in flight per worker keeps everyone busy while the writer catches up
+	ReorderBuffer reorderBuffer( threadCount * 2 );
+	const double start = Clock::now();
+
+	std::vector< std::thread > workers;
+	for ( int i = 0; i < threadCount; i++ )
+	{
+		workers.emplace_back( [ & ]
+		{
+			Raster::Framebuffer framebuffer( width, height );
+			Raster::StaticLayer staticLayer;
+			// frames are read as they are rendered, each worker through readers of its own
+			std::vector< Replay::Reader > readers;
+			for ( Replay::Sequence const& replay : sequences )
+				if ( !replay.times.empty() )
+					readers.emplace_back( replay );
+			std::vector< Scene::Frame const* > tables;
+			Scene::Frame gridFrame;
+			Grid::Composer composer;
+			for ( int frame = reorderBuffer.takeFrame( frameCount ); frame >= 0; frame = reorderBuffer.takeFrame( frameCount ) )
+			{
+				const double time = frame * framePeriod;
+				if ( sequences.size() == 1 )
+					Raster::render( readers.front().frameAt( time ), framebuffer, staticLayer );
+				else
+				{
+					tables.clear();
+					for ( Replay::Reader& reader : readers )
+						tables.push_back( &reader.frameAt( time ) );
+					composer.compose( tables, layout, camera, gridFrame );
+					Raster::render( gridFrame, framebuffer, staticLayer );
+				}
+				if ( format == Format::y4m )
+					encodeYuv( framebuffer, reorderBuffer.slotData( frame ) );
+				else
+					encodeRgba( framebuffer, reorderBuffer.slotData( frame ) );
+				reorderBuffer.markReady( frame );
+			}
+		} );
+	}
+
+	for ( int frame = 0; frame < frameCount; frame++ )
+	{
+		std::vector< char > const& data = reorderBuffer.waitFrame( frame );
+		if ( format == Format::y4m )
+			output << "FRAME\n";
+		output.write( data.data(), std::streamsize( data.size() ) );
+		reorderBuffer.release( frame );
+	}
+
+	for ( std::thread& worker : workers )
+		worker.join();
+
+	const double elapsed = Clock::now() - start;
+	const double duration = sequence.framesPerSecond > 0 ? double( frameCount ) / sequence.framesPerSecond : 0.0;
+	std::printf( "%d frames in %.2f s with %d threads: %.1f fps, %.1fx real time\n",
+		frameCount, elapsed, threadCount, frameCount / elapsed, elapsed > 0.0 ? duration / elapsed : 0.0 );
+
+	return output ? 0 : 1;
+}
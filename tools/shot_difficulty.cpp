@@ -0,0 +1,145 @@
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "../framework/clock.hpp"
+#include "../framework/game.hpp"
+#include "../framework/shot_difficulty.hpp"
+#include "../framework/thread_pool.hpp"
+
+
+//-------------------------------------------------------
+//	difficulty map: for the table the break leaves, how
+//	likely a player with the given cue noise pockets each
+//	ball aimed at straight from the cue ball, at every
+//	charge; all estimates sampled together on all cores
+//-------------------------------------------------------
+
+namespace
+{
+	const float powers[] = { 0.2f, 0.4f, 0.6f, 0.8f, 1.f };
+	const int powerCount = int( sizeof( powers ) / sizeof( powers[ 0 ] ) );
+
+
+	struct Options
+	{
+		ShotDifficulty::Settings settings;
+		int threads = 0;
+		char const* outputPath = nullptr;
+	};
+
+	Options options;
+
+
+	bool parseOptions( int argc, char* argv[] )
+	{
+		ShotDifficulty::Settings& settings = options.settings;
+		for ( int i = 1; i < argc; i++ )
+		{
+			const bool hasValue = i + 1 < argc;
+			if ( std::strcmp( argv[ i ], "--angle" ) == 0 && hasValue )
+				settings.noise.angle = float( std::atof( argv[ ++i ] ) );
+			else if ( std::strcmp( argv[ i ], "--power" ) == 0 && hasValue )
+				settings.noise.power = float( std::atof( argv[ ++i ] ) );
+			else if ( std::strcmp( argv[ i ], "--uniform" ) == 0 )
+				settings.noise.distribution = ShotDifficulty::Noise::Distribution::uniform;
+			else if ( std::strcmp( argv[ i ], "--width" ) == 0 && hasValue )
+				settings.halfWidth = float( std::atof( argv[ ++i ] ) );
+			else if ( std::strcmp( argv[ i ], "--samples" ) == 0 && hasValue )
+				settings.maxSamples = std::atoi( argv[ ++i ] );
+			else if ( std::strcmp( argv[ i ], "--seed" ) == 0 && hasValue )
+				settings.seed = unsigned( std::strtoul( argv[ ++i ], nullptr, 10 ) );
+			else if ( std::strcmp( argv[ i ], "--threads" ) == 0 && hasValue )
+				options.threads = std::atoi( argv[ ++i ] );
+			else if ( std::strcmp( argv[ i ], "--out" ) == 0 && hasValue )
+				options.outputPath = argv[ ++i ];
+			else
+				return false;
+		}
+		return settings.maxSamples > 0 && settings.halfWidth > 0.f && settings.noise.angle >= 0.f && settings.noise.power >= 0.f;
+	}
+
+
+	bool writeMap( char const* path, std::vector< ShotDifficulty::Request > const& requests, std::vector< ShotDifficulty::Estimate > const& estimates )
+	{
+		std::FILE* file = std::fopen( path, "w" );
+		if ( !file )
+			return false;
+
+		std::fprintf( file, "ball,power,probability,low,high,samples\n" );
+		for ( size_t i = 0; i < requests.size(); i++ )
+			std::fprintf( file, "%d,%.2f,%.4f,%.4f,%.4f,%d\n", requests[ i ].target, requests[ i ].shot.power,
+				estimates[ i ].probability, estimates[ i ].low, estimates[ i ].high, estimates[ i ].samples );
+		return std::fclose( file ) == 0;
+	}
+}
+
+
+int main( int argc, char* argv[] )
+{
+	if ( !parseOptions( argc, argv ) )
+	{
+		std::printf( "usage: shot_difficulty [--angle radians] [--power charge] [--uniform] [--width half width]\n"
+			"                       [--samples max] [--seed n] [--threads n] [--out map.csv]\n"
+			"cue noise is normal with the given standard deviations, or uniform with them as half widths;\n"
+			"every estimate samples until its 95%% interval is within the half width or at the sample limit\n" );
+		return 1;
+	}
+
+	// the break, straight at the head ball
+	Game::ShotSimulator simulator;
+	const Game::TableState table = simulator.simulate( simulator.rack(), Game::Shot() ).rest;
+
+	std::vector< ShotDifficulty::Request > requests;
+	for ( int id = 1; id < int( table.size() ); id++ )
+	{
+		if ( table[ id ].isPocketed )
+			continue;
+		for ( float power : powers )
+		{
+			ShotDifficulty::Request request;
+			request.table = table;
+			request.shot.directionX = table[ id ].x - table[ 0 ].x;
+			request.shot.directionY = table[ id ].y - table[ 0 ].y;
+			request.shot.power = power;
+			request.target = id;
+			requests.push_back( request );
+		}
+	}
+
+	ThreadPool pool( options.threads );
+	ShotDifficulty difficulty( pool );
+	difficulty.setSettings( options.settings );
+	const double start = Clock::now();
+	const std::vector< ShotDifficulty::Estimate > estimates = difficulty.estimate( requests );
+	const double elapsed = Clock::now() - start;
+
+	std::printf( "%-14s", "ball \\ power" );
+	for ( float power : powers )
+		std::printf( " %18.1f", power );
+	std::printf( "\n" );
+
+	int samples = 0;
+	for ( size_t i = 0; i < requests.size(); i++ )
+	{
+		ShotDifficulty::Request const& request = requests[ i ];
+		ShotDifficulty::Estimate const& estimate = estimates[ i ];
+		if ( i % powerCount == 0 )
+			std::printf( "%2d (%5.2f %5.2f)", request.target, table[ request.target ].x, table[ request.target ].y );
+		std::printf( "  %4.2f [%4.2f, %4.2f]", estimate.probability, estimate.low, estimate.high );
+		if ( i % powerCount == powerCount - 1 )
+			std::printf( "\n" );
+		samples += estimate.samples;
+	}
+	std::printf( "%d shots, %d samples of at most %d, %.2f s with %d threads\n", int( requests.size() ), samples,
+		int( requests.size() ) * options.settings.maxSamples, elapsed, pool.size() );
+
+	if ( options.outputPath && !writeMap( options.outputPath, requests, estimates ) )
+	{
+		std::printf( "can't write %s\n", options.outputPath );
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,293 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+#include "../framework/clock.hpp"
+#include "../framework/game.hpp"
+#include "../framework/shot_cache.hpp"
+#include "../framework/thread_pool.hpp"
+#include "../framework/transposition_table.hpp"
+
+
+//-------------------------------------------------------
+//	shot search: negamax with alpha-beta over a few
+//	candidate shots per turn, deepened a turn at a time;
+//	the player who pockets a ball shoots again, a scratch
+//	ends the line; every root shot is searched on its own
+//	thread, all of them share one transposition table
+//	and one shot cache, which spares every deeper pass
+//	simulating the shots of the passes before it again
+//-------------------------------------------------------
+
+namespace
+{
+	// every ball on the table aimed at straight from the cue ball, at each of these charges
+	const float powers[] = { 0.5f, 1.f };
+	const int powerCount = int( sizeof( powers ) / sizeof( powers[ 0 ] ) );
+	const float infinity = std::numeric_limits< float >::infinity();
+
+
+	struct Options
+	{
+		int depth = 3;
+		int threads = 0;
+		// 0 searches without a table, or simulates every shot
+		int tableMegabytes = 64;
+		int cacheMegabytes = 64;
+	};
+
+	Options options;
+
+
+	struct Position
+	{
+		Game::TableState table;
+		// Game::hashTable( table )
+		uint64_t hash = 0;
+		int player = 0;
+	};
+
+
+	struct Counters
+	{
+		uint64_t shots = 0;
+		uint64_t probes = 0;
+		uint64_t hits = 0;
+		uint64_t cutoffs = 0;
+
+		void add( Counters const& other )
+		{
+			shots += other.shots;
+			probes += other.probes;
+			hits += other.hits;
+			cutoffs += other.cutoffs;
+		}
+	};
+
+
+	// a move names a ball and a charge, so it means the same in every position;
+	// false when that ball is off the table here
+	bool moveShot( Game::TableState const& table, int move, Game::Shot& shot )
+	{
+		const int id = move / powerCount;
+		if ( id <= 0 || id >= int( table.size() ) || table[ id ].isPocketed || table[ 0 ].isPocketed )
+			return false;
+
+		shot.directionX = table[ id ].x - table[ 0 ].x;
+		shot.directionY = table[ id ].y - table[ 0 ].y;
+		shot.power = powers[ move % powerCount ];
+		return true;
+	}
+
+
+	int moveCount( Game::TableState const& table )
+	{
+		return int( table.size() ) * powerCount;
+	}
+
+
+	bool hasObjectBalls( Game::TableState const& table )
+	{
+		for ( size_t id = 1; id < table.size(); id++ )
+			if ( !table[ id ].isPocketed )
+				return true;
+		return false;
+	}
+
+
+	// one worker's search, with a simulator of its own
+	class Search
+	{
+	public:
+		Search( TranspositionTable* table, ShotCache* cache ) :
+			table( table ),
+			cache( cache )
+		{
+		}
+
+		// the shooter's balls minus the opponent's over the next depth turns
+		float shoot( Position const& position, int move, int depth, float alpha, float beta );
+		float search( Position const& position, int depth, float alpha, float beta );
+
+		Counters counters;
+
+	private:
+		Game::ShotSimulator simulator;
+		TranspositionTable* table;
+		ShotCache* cache;
+	};
+
+
+	// the value of one shot for the player taking it; -infinity when it isn't there to take
+	float Search::shoot( Position const& position, int move, int depth, float alpha, float beta )
+	{
+		Game::Shot shot;
+		if ( !moveShot( position.table, move, shot ) )
+			return -infinity;
+
+		Game::ShotOutcome outcome = cache ? cache->simulate( simulator, position.table, shot ) : simulator.simulate( position.table, shot );
+		counters.shots++;
+
+		float gain = 0.f;
+		for ( int id : outcome.pocketed )
+			gain += id == 0 ? -1.f : 1.f;
+		if ( outcome.isScratch || depth <= 1 || !hasObjectBalls( outcome.rest ) )
+			return gain;
+
+		Position next;
+		next.table = std::move( outcome.rest );
+		next.hash = outcome.hash;
+		if ( gain > 0.f )
+		{
+			next.player = position.player;
+			return gain + search( next, depth - 1, alpha - gain, beta - gain );
+		}
+		next.player = 1 - position.player;
+		return gain - search( next, depth - 1, gain - beta, gain - alpha );
+	}
+
+
+	float Search::search( Position const& position, int depth, float alpha, float beta )
+	{
+		const uint64_t key = position.hash ^ Game::hashGameState( uint32_t( position.player ) );
+		const float originalAlpha = alpha;
+
+		TranspositionTable::Entry entry;
+		int firstMove = -1;
+		if ( table )
+		{
+			counters.probes++;
+			if ( table->probe( key, entry ) )
+			{
+				counters.hits++;
+				firstMove = entry.move;
+				if ( entry.depth >= depth )
+				{
+					if ( entry.bound == TranspositionTable::Bound::lower )
+						alpha = std::max( alpha, entry.value );
+					else if ( entry.bound == TranspositionTable::Bound::upper )
+						beta = std::min( beta, entry.value );
+					if ( entry.bound == TranspositionTable::Bound::exact || alpha >= beta )
+					{
+						counters.cutoffs++;
+						return entry.value;
+					}
+				}
+			}
+		}
+
+		// the table's best move first, the rest in order
+		float best = -infinity;
+		int bestMove = -1;
+		const int count = moveCount( position.table );
+		for ( int i = -1; i < count && alpha < beta; i++ )
+		{
+			const int move = i < 0 ? firstMove : i;
+			if ( move < 0 || ( i >= 0 && move == firstMove ) )
+				continue;
+
+			const float value = shoot( position, move, depth, alpha, beta );
+			if ( value > best )
+			{
+				best = value;
+				bestMove = move;
+			}
+			alpha = std::max( alpha, value );
+		}
+
+		if ( table && bestMove >= 0 )
+		{
+			entry.value = best;
+			entry.depth = depth;
+			entry.bound = best <= originalAlpha ? TranspositionTable::Bound::upper : best >= beta ? TranspositionTable::Bound::lower : TranspositionTable::Bound::exact;
+			entry.move = bestMove;
+			table->store( key, entry );
+		}
+		return best;
+	}
+
+
+	bool parseOptions( int argc, char* argv[] )
+	{
+		for ( int i = 1; i < argc; i++ )
+		{
+			const bool hasValue = i + 1 < argc;
+			if ( std::strcmp( argv[ i ], "--depth" ) == 0 && hasValue )
+				options.depth = std::atoi( argv[ ++i ] );
+			else if ( std::strcmp( argv[ i ], "--threads" ) == 0 && hasValue )
+				options.threads = std::atoi( argv[ ++i ] );
+			else if ( std::strcmp( argv[ i ], "--table" ) == 0 && hasValue )
+				options.tableMegabytes = std::atoi( argv[ ++i ] );
+			else if ( std::strcmp( argv[ i ], "--cache" ) == 0 && hasValue )
+				options.cacheMegabytes = std::atoi( argv[ ++i ] );
+			else
+				return false;
+		}
+		return options.depth > 0 && options.tableMegabytes >= 0 && options.cacheMegabytes >= 0;
+	}
+}
+
+
+int main( int argc, char* argv[] )
+{
+	if ( !parseOptions( argc, argv ) )
+	{
+		std::printf( "usage: shot_search [--depth turns] [--threads n] [--table megabytes] [--cache megabytes]\n"
+			"searches the table the break leaves, one more turn per pass up to the depth;\n"
+			"--table 0 searches without the transposition table, --cache 0 simulates every shot\n" );
+		return 1;
+	}
+
+	// the break, straight at the head ball
+	Game::ShotSimulator simulator;
+	Position root;
+	const Game::ShotOutcome opening = simulator.simulate( simulator.rack(), Game::Shot() );
+	root.table = opening.rest;
+	root.hash = opening.hash;
+
+	std::unique_ptr< TranspositionTable > table;
+	if ( options.tableMegabytes > 0 )
+		table.reset( new TranspositionTable( size_t( options.tableMegabytes ) << 20 ) );
+	std::unique_ptr< ShotCache > cache;
+	if ( options.cacheMegabytes > 0 )
+		cache.reset( new ShotCache( size_t( options.cacheMegabytes ) << 20 ) );
+
+	ThreadPool pool( options.threads );
+	const int count = moveCount( root.table );
+	Counters total;
+	uint64_t simulated = 0;
+	const double start = Clock::now();
+	for ( int depth = 1; depth <= options.depth; depth++ )
+	{
+		std::vector< float > values( count );
+		std::vector< Counters > counters( count );
+		const double passStart = Clock::now();
+		const uint64_t missesBefore = cache ? cache->stats().misses : 0;
+		pool.parallelFor( count, [ & ]( int move )
+		{
+			Search search( table.get(), cache.get() );
+			values[ move ] = search.shoot( root, move, depth, -infinity, infinity );
+			counters[ move ] = search.counters;
+		} );
+
+		Counters pass;
+		for ( Counters const& worker : counters )
+			pass.add( worker );
+		total.add( pass );
+		// every cache miss is simulated, without a cache every shot is
+		const uint64_t passSimulated = cache ? cache->stats().misses - missesBefore : pass.shots;
+		simulated += passSimulated;
+
+		const int best = int( std::max_element( values.begin(), values.end() ) - values.begin() );
+		std::printf( "depth %d: ball %d at power %.1f, %+.0f balls, %llu shots, %llu simulated, %llu of %llu table probes hit, %llu cut off, %.2f s\n",
+			depth, best / powerCount, powers[ best % powerCount ], values[ best ], (unsigned long long)pass.shots, (unsigned long long)passSimulated,
+			(unsigned long long)pass.hits, (unsigned long long)pass.probes, (unsigned long long)pass.cutoffs, Clock::now() - passStart );
+	}
+	std::printf( "%llu shots, %llu simulated in %.2f s with %d threads\n", (unsigned long long)total.shots, (unsigned long long)simulated,
+		Clock::now() - start, pool.size() );
+	return 0;
+}